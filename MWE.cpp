@@ -1,9 +1,6 @@
 #include <KIG.h>
-#include <chrono>
 
-#define BUFFER_SIZE 10                                          //adjustable.
 std::string config_f = "/conf/config.toml";                  
-struct sysinfo s_info;                                          //structure needed to access uptime info
 
 /*-------------------------------------------------------------
  *
@@ -11,51 +8,135 @@ struct sysinfo s_info;                                          //structure need
  *
  * ------------------------------------------------------------*/
 
+static void summary (HWconfig& conf, EnergyAccumulator& acc, Scheduler& sched) {
+    std::cout << "===============================================" << '\n';
+    std::cout << "Now evaluating carbon footprint of execution..." << '\n';
+    std::cout << "===============================================" << '\n';
+    std::cout << "AVG_CPU_USAGE: " << acc.cpu().mean << '\n';
+    std::cout << "AVG_MEM_ALLOC (GB): " << acc.mem().mean << '\n';
+    std::cout << "AVG ABSORBED W: " << acc.power().mean << " (max " << acc.power().max << ")" << '\n';
+    std::cout << "ENERGY (J): " << acc.joules() << '\n';
+    std::cout << "ELAPSED T: " << acc.elapsed() << '\n';
+    std::cout << "SAMPLES: " << sched.ticks() << ", MISSED DEADLINES: " << sched.missed() << '\n';
+    std::cout << "JITTER (s): mean " << sched.jitter().mean << ", max " << sched.jitter().max << '\n';
+    std::cout << "YOUR FOOTPRINT: " << acc.footprint() << " gCO2e" << '\n';
+    makeReport(conf, acc.elapsed(), acc.footprint());           //report.txt is only rendered by --report
+}
+
+//picks up a reloaded config.toml between two samples: acc and the energy source point to conf.
+//Returns true when the reload selects another energy source, which must then be rebuilt
+static bool refresh (const ConfigWatcher& watcher, std::size_t& seen, HWconfig& conf, Scheduler& sched, double default_ms) {
+    if (watcher.generation() == seen) {
+        return false;
+    }
+    seen = watcher.generation();
+    const HWconfig old = conf;
+    conf = *watcher.current();
+    sched.setPeriod(conf.sampling_period_ms > 0 ? conf.sampling_period_ms : default_ms);
+    std::cout << "configuration reloaded from: " << config_f << '\n';
+    return !sameEnergySource(old, conf);
+}
+
+//runs loop on the concrete source (no virtual call per sample) until it returns false.
+//loop returns true after a reload that selects another source: it then goes on with the new one
+template <typename Loop>
+static void sampleWith (std::unique_ptr<EnergySource>& source, EnergyAccumulator& acc, const HWconfig& conf, Loop loop) {
+    bool rebuild = true;
+    while (rebuild) {
+        visitEnergySource(*source, [&] (auto& power) { rebuild = loop(power); });
+        if (rebuild) {
+            source = makeEnergySource(conf);
+            acc.setSource(*source);
+            std::cout << "energy source rebuilt: " << conf.energy_source << '\n';
+        }
+    }
+}
 
 int main (int argc, char** argv) {
+
+    if (argc == 2 && std::string(argv[1]) == "--report") {
+        //only (re)generate report.txt from the records of the completed runs
+        std::cout << renderReport() << " runs in report.txt" << '\n';
+        return 0;
+    }
    
-    HWconfig conf;
-    pullConfig(conf, config_f);
+    ConfigWatcher watcher(config_f, true);                      //reloads config_f whenever it is edited, cached in config_f.kigcache
+    HWconfig conf = *watcher.current();
+    std::size_t seen = watcher.generation();
     CPUsage monitor;
-    
-    std::vector<std::string> proc_buffer;                        //reading buffer for storing the content of /proc/$pid/stat
+    auto source = makeEnergySource(conf);
+    EnergyAccumulator acc(conf, *source);                       //the sampling loops are instantiated for the concrete source, see sampleWith()
+
+    std::unique_ptr<SampleLog> log;                             //optional binary log of every sample
+    if (!conf.sample_log.empty()) {
+        log = std::make_unique<SampleLog>(conf.sample_log);
+    }
+
+    std::unique_ptr<MetricsExporter> exporter;                  //optional Prometheus endpoint, one slot per PID
+    if (!conf.metrics.empty()) {
+        exporter = std::make_unique<MetricsExporter>(conf.metrics, (argc == 3 && std::string(argv[1]) == "--tree") ? 1 : argc - 1);
+    }
+
+    if (argc == 3 && std::string(argv[1]) == "--tree") {
 
-    std::vector<double> cpu_usage_buffer;
-    cpu_usage_buffer.reserve(BUFFER_SIZE);
+        //process-tree mode: ./KIG_ex --tree <root_pid> follows every descendant of root_pid
+        MemStatus tree_mem;
+        ProcessTree tree(conf, std::stoi(argv[2]));
+        Scheduler sched(conf.sampling_period_ms > 0 ? conf.sampling_period_ms : 5000);
+        std::cout << "process tree rooted at: " << argv[2] << " is under monitoring" << '\n';
 
-    std::vector<double> mem_allocation;
-    mem_allocation.reserve(BUFFER_SIZE);
+        sampleWith(source, acc, conf, [&] (auto& power) {
+            while (tree.sample(monitor, tree_mem)) {
+                std::cout << "processes in tree: " << tree.size() << '\n';
+                monitor.up_time = upTime();
+                acc.push(monitor.up_time, CPUusageDelta(monitor, conf), monitor.vm_size/1000000, power);
+                if (log) {
+                    log->push(monitor.up_time, std::stoi(argv[2]), monitor.utime, monitor.stime, monitor.rss, acc.lastPower());
+                }
+                if (exporter) {
+                    exporter->publish(0, std::stoi(argv[2]), acc);
+                }
+                sched.wait();
+                if (refresh(watcher, seen, conf, sched, 5000)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+        summary(conf, acc, sched);
+        return 0;
+    }
 
     auto pid = std::string(argv[1]);
     auto path = conf.root_folder + pid + conf.cpu_stat_file;
-    auto path_mem = conf.root_folder + pid + conf.mem_stat_file;
-    
-    std::filesystem::path PROCESS_FOLDER {path};
     
     if (argc == 2) {
 
         std::cout << "process: " << pid << " is under monitoring" << '\n';
         std::cout << "pulling configuration from: " << path << '\n';
 
-        do {
-            fillBuffer(proc_buffer, path);
-            mem_allocation.push_back(fetchMem(path_mem));
-	    std::cout << mem_allocation << '\n';
-            update(monitor, proc_buffer, s_info);
-            cpu_usage_buffer.push_back(CPUusage(monitor, conf));
-	    std::cout << cpu_usage_buffer << '\n';
-            flushBuffer(proc_buffer);
-            sleep(10);
-        } while (std::filesystem::exists(PROCESS_FOLDER))/*cpu_usage_buffer.size() != BUFFER_SIZE*/;
-    
-        double e_time = monitor.elapsed_time;
-    //std::cout << " This was the cpu usage throughout computing: " << cpu_usage_buffer;
-        std::cout << "===============================================" << '\n';
-        std::cout << "Now evaluating carbon footprint of execution..." << '\n';
-        std::cout << "===============================================" << '\n';
-        auto footprint = carbonFootprint(cpu_usage_buffer, mem_allocation, conf, e_time/3600.);
-        std::cout << "YOUR FOOTPRINT: " << footprint << " gCO2e" << '\n';
-        makeReport(conf, e_time, footprint);
+        ProcHandle handle(conf, std::stoi(pid));
+        Scheduler sched(conf.sampling_period_ms > 0 ? conf.sampling_period_ms : 10000);
+
+        sampleWith(source, acc, conf, [&] (auto& power) {
+            while (handle.sample(monitor)) {
+                monitor.up_time = upTime();
+                acc.push(monitor.up_time, CPUusageDelta(monitor, conf), monitor.vm_size/1000000, power);
+                if (log) {
+                    log->push(monitor.up_time, handle.pid(), monitor.utime, monitor.stime, monitor.rss, acc.lastPower());
+                }
+                if (exporter) {
+                    exporter->publish(0, handle.pid(), acc);
+                }
+                std::cout << "footprint so far: " << acc.footprint() << " gCO2e" << '\n';
+                sched.wait();
+                if (refresh(watcher, seen, conf, sched, 10000)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+        summary(conf, acc, sched);
     } 
     
     else {
@@ -65,58 +146,43 @@ int main (int argc, char** argv) {
         }
         std::cout << '\n';
 
+        std::vector<pid_t> pids;
+        for(int i=1; i<argc; i++){
+            pids.push_back(std::stoi(argv[i]));
+        }
+        ShardedSampler sampler(conf, pids, conf.sampler_threads);   //one worker per NUMA node by default
+        std::vector<EnergyAccumulator> per_pid(exporter ? pids.size() : 0, EnergyAccumulator(conf));   //fed with their part of acc's power
+        Scheduler sched(conf.sampling_period_ms > 0 ? conf.sampling_period_ms : 5000);
         
-        
-        auto tock = std::chrono::steady_clock::now();
-        
-        while(std::filesystem::exists(PROCESS_FOLDER)){
-        	for(int i=1; i<argc; i++){
-        		
-                auto pid_multi = std::string(argv[i]);
-                auto path_multi  = conf.root_folder + pid_multi + conf.cpu_stat_file;
-                auto path_mem_multi = conf.root_folder + pid_multi + conf.mem_stat_file;
-			if(std::filesystem::exists(path_multi)){		
-				std::cout << "pulling configuration from: " << path_multi << '\n';
-				
-                		fillBuffer(proc_buffer, path_multi);
-                		mem_allocation.push_back(fetchMem(path_mem_multi));
-                		update(monitor, proc_buffer, s_info);
-                		cpu_usage_buffer.push_back(CPUusage(monitor,conf));
-                		flushBuffer(proc_buffer);
-                //congegnare l'equivalente operazione
-				}
-			else{
-				continue;
-			} 
+        sampleWith(source, acc, conf, [&] (auto& power) {
+            while(sampler.tick() != 0){
+                //one aggregated sample per tick for the whole PID set, the first one opens the interval
+                CPUreading r{sampler.totalIntervalUsage(), sampler.totalUsage(), sampler.interval()};
+                acc.push(sampler.up_time(), r, sampler.totalVmSize()/1000000, power);
+                for (std::size_t k = 0; (log || exporter) && k < sampler.shards(); k++) {
+                    const Sampler& shard = sampler.shard(k);
+                    for (std::size_t i = 0; i < shard.size(); i++) {
+                        double usage = shard.intervalUsage(i, conf);
+                        double mem_gb = shard.vm_size()[i]/1000000.;
+                        //this PID's part of the power acc just took from the energy source
+                        PowerSample p = pidPower(acc.lastSample(), usage, r.interval, mem_gb, sampler.totalVmSize()/1000000);
+                        if (log) {
+                            log->push(shard.up_time(), shard.pid(i), shard.utime()[i], shard.stime()[i], shard.rss()[i], p.cpu + p.mem);
+                        }
+                        if (exporter) {
+                            std::size_t slot = sampler.offset(k) + i;
+                            per_pid[slot].push(shard.up_time(), CPUreading{usage, usage, shard.interval()}, mem_gb, p);
+                            exporter->publish(slot, shard.pid(i), per_pid[slot]);
+                        }
+                    }
+                }
+                sched.wait();
+                if (refresh(watcher, seen, conf, sched, 5000)) {
+                    return true;
+                }
             }
-            sleep(5);   
-        }
-       auto tick = std::chrono::steady_clock::now();
-       
-       std::chrono::duration<double> e_time = tick-tock;
-       
-       auto cpu_agg = std::accumulate(std::begin(cpu_usage_buffer),
-       								  std::end(cpu_usage_buffer),
-       								  0.);
-       
-       auto cpu_mean = cpu_agg / cpu_usage_buffer.size();
-       
-       auto mem_agg = std::accumulate(std::begin(mem_allocation),
-       								  std::end(mem_allocation),
-       								  0.);
-       
-       auto mem_mean = mem_agg / mem_allocation.size();
-       
-       std::cout << "===============================================" << '\n';
-       std::cout << "Now evaluating carbon footprint of execution..." << '\n';
-       std::cout << "===============================================" << '\n';
-       auto footprint = carbonFootprint(cpu_usage_buffer, 
-       									mem_allocation, 
-       									conf, 
-       									e_time.count()/3600);
-       									
-       std::cout << "YOUR FOOTPRINT: " << footprint << " gCO2e" << '\n';
-       makeReport(conf, e_time.count(), footprint);
+            return false;
+        });
+        summary(conf, acc, sched);
     }
 }
-
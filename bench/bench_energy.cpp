@@ -0,0 +1,66 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Per-sample cost of the energy sources: TdpModel against
+ *  PowercapCounters reading a fake powercap folder (one
+ *  package and one dram zone), so no RAPL hardware is needed.
+ *
+ * ------------------------------------------------------------*/
+
+static HWconfig energyConfig () {
+    HWconfig hw;
+    hw.n_cpu = 2;
+    hw.cpu_tdp = 10;
+    hw.ram_power_usage = 0.375;
+    hw.pue = 1.5;
+    hw.carbon_intensity = 100;
+    hw.energy_source = "powercap";
+    hw.powercap_root = (std::filesystem::temp_directory_path() / "kig_fake_powercap/").string();
+    return hw;
+}
+
+static void fakeZone (const std::string& root, const std::string& zone, const std::string& name) {
+    std::filesystem::create_directories(root + zone);
+    std::ofstream(root + zone + "/name") << name << '\n';
+    std::ofstream(root + zone + "/energy_uj") << 1000 << '\n';
+    std::ofstream(root + zone + "/max_energy_range_uj") << 262143328850ULL << '\n';
+}
+
+static void BM_TdpModel_power (benchmark::State& state) {
+    HWconfig hw = energyConfig();
+    TdpModel model(hw);
+    CPUreading r{0.5, 0.5, 1.};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.power(r, 2.));
+    }
+}
+BENCHMARK(BM_TdpModel_power);
+
+static void BM_PowercapCounters_power (benchmark::State& state) {
+    HWconfig hw = energyConfig();
+    fakeZone(hw.powercap_root, "intel-rapl:0", "package-0");
+    fakeZone(hw.powercap_root, "intel-rapl:0:2", "dram");
+    PowercapCounters counters(hw);
+    CPUreading r{0.5, 0.5, 1.};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(counters.power(r, 2.));
+    }
+    state.counters["domains"] = counters.domains();
+    std::filesystem::remove_all(hw.powercap_root);
+}
+BENCHMARK(BM_PowercapCounters_power);
+
+static void BM_EnergyAccumulator_push (benchmark::State& state) {
+    HWconfig hw = energyConfig();
+    EnergyAccumulator acc(hw);
+    CPUreading r{0.5, 0.5, 1.};
+    double t = 0;
+    for (auto _ : state) {
+        acc.push(t, r, 2.);
+        t += 1.;
+    }
+    benchmark::DoNotOptimize(acc.footprint());
+}
+BENCHMARK(BM_EnergyAccumulator_push);
@@ -0,0 +1,64 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Output cost of a 100k-sample run of CPUusage() and of
+ *  carbonFootprint() on 100k samples: log records off (the
+ *  default) against the records streamed at debug level, as
+ *  std::cout used to be on every sample (here to /dev/null,
+ *  so the terminal is not part of the measure).
+ *
+ * ------------------------------------------------------------*/
+
+static const int n_samples = 100000;
+
+static HWconfig logConfig () {
+    HWconfig hw;
+    hw.n_cpu = 2;
+    hw.cpu_tdp = 10;
+    hw.clock_ticks = 100;
+    hw.ram_power_usage = 0.375;
+    hw.pue = 1.5;
+    hw.carbon_intensity = 100;
+    return hw;
+}
+
+static void BM_CPUusage_100k (benchmark::State& state) {
+    std::ofstream devnull("/dev/null");
+    if (state.range(0)) {
+        setLogSink(streamLogSink(devnull), LogLevel::debug);
+    }
+    HWconfig hw = logConfig();
+    CPUsage c;
+    c.starttime = 100;
+    for (auto _ : state) {
+        double sum = 0;
+        for (int i = 0; i < n_samples; i++) {
+            c.utime = 100 + i;
+            c.stime = 10 + i/10;
+            c.up_time = 10. + i;
+            sum += CPUusage(c, hw);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setLogSink(streamLogSink(std::cerr), LogLevel::warning);
+    state.SetItemsProcessed(state.iterations() * n_samples);
+}
+BENCHMARK(BM_CPUusage_100k)->ArgName("logged")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_carbonFootprint_100k (benchmark::State& state) {
+    std::ofstream devnull("/dev/null");
+    if (state.range(0)) {
+        setLogSink(streamLogSink(devnull), LogLevel::debug);
+    }
+    HWconfig hw = logConfig();
+    std::vector<double> cpu(n_samples, 0.5);
+    std::vector<double> mem(n_samples, 2.);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(carbonFootprint(cpu, mem, hw, n_samples));
+    }
+    setLogSink(streamLogSink(std::cerr), LogLevel::warning);
+    state.SetItemsProcessed(state.iterations() * n_samples);
+}
+BENCHMARK(BM_carbonFootprint_100k)->ArgName("logged")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
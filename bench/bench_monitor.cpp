@@ -0,0 +1,33 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Cost, on the host application side, of reading the
+ *  readings of a running Monitor.
+ *
+ * ------------------------------------------------------------*/
+
+static void BM_Monitor_snapshot (benchmark::State& state) {
+    HWconfig hw;
+    hw.root_folder = "/proc/";
+    hw.cpu_stat_file = "/stat";
+    hw.mem_stat_file = "/status";
+    hw.clock_ticks = 100;
+    hw.n_cpu = 1;
+    hw.cpu_tdp = 10;
+    hw.ram_power_usage = 0.375;
+    hw.pue = 1;
+    hw.carbon_intensity = 100;
+    hw.sampling_period_ms = 1;
+    hw.energy_source = "tdp";
+
+    Monitor monitor(hw);
+    monitor.start();
+    for (auto _ : state) {
+        MonitorSnapshot snap = monitor.snapshot();
+        benchmark::DoNotOptimize(snap);
+    }
+    monitor.stop();
+}
+BENCHMARK(BM_Monitor_snapshot)->ThreadRange(1, 4);
@@ -0,0 +1,225 @@
+#include "synthetic_proc.h"
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  The remaining steps of the KIG pipeline one by one
+ *  (fillBuffer, update, fetchMem, CPUusage, carbonFootprint,
+ *  pullConfig with and without its binary cache, decodeConfig
+ *  against the chained toml::find calls it replaced, makeReport,
+ *  renderReport), then end-to-end throughput of a sampling tick
+ *  (Sampler, CPU usage, energy accumulation) for 1, 100 and 10k
+ *  PIDs on a synthetic /proc tree advanced by one second between
+ *  ticks.
+ *
+ * ------------------------------------------------------------*/
+
+static const SyntheticProc& procTree () {
+    static const SyntheticProc tree([] { SyntheticSpec spec; spec.n_pids = 1; return spec; }());
+    return tree;
+}
+
+static std::string tempPath (const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("kig_bench_" + std::to_string(getpid()) + "_" + name)).string();
+}
+
+static HWconfig pipelineConfig () {
+    HWconfig hw = procTree().config();
+    hw.exp_name = "bench";
+    return hw;
+}
+
+static void BM_fillBuffer (benchmark::State& state) {
+    std::string path = procTree().path(0, "/stat");
+    std::vector<std::string> v;
+    for (auto _ : state) {
+        fillBuffer(v, path);
+        benchmark::DoNotOptimize(v.data());
+        flushBuffer(v);
+    }
+}
+BENCHMARK(BM_fillBuffer);
+
+static void BM_update (benchmark::State& state) {
+    std::vector<std::string> v;
+    fillBuffer(v, procTree().path(0, "/stat"));
+    CPUsage c;
+    struct sysinfo T;
+    for (auto _ : state) {
+        update(c, v, T);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_update);
+
+static void BM_fetchMem (benchmark::State& state) {
+    std::string path = procTree().path(0, "/status");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fetchMem(path));
+    }
+}
+BENCHMARK(BM_fetchMem);
+
+static void BM_CPUusage (benchmark::State& state) {
+    HWconfig hw = pipelineConfig();
+    CPUsage c;
+    readStat(c, procTree().path(0, "/stat"));
+    c.up_time = upTime();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CPUusage(c, hw));
+    }
+}
+BENCHMARK(BM_CPUusage);
+
+static void BM_carbonFootprint (benchmark::State& state) {
+    HWconfig hw = pipelineConfig();
+    std::vector<double> cpu(state.range(0), 0.5);
+    std::vector<double> mem(state.range(0), 2.);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(carbonFootprint(cpu, mem, hw, 3600.));
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_carbonFootprint)->Range(8, 1 << 16);
+
+static const char* const config_toml =
+    "[owner]\nname = \"XXX\"\ntitle = \"bench\"\n\n"
+    "[infrastructure]\nroot_folder = \"/proc/\"\ncpu_stat_file = \"/stat\"\nmem_stat_file = \"/status\"\n"
+    "cpu_family = \"Skylake\"\ncpu_tdp = 8\nn_cpu = 2\nclock_ticks = 100\n"
+    "ram_family = \"DDR4\"\nram_freq = 2133\nram_slots = 1\n\n"
+    "[energy]\ncarbon_intensity = 100.0\npower_usage_efficiency = 1.01\n";
+
+static void BM_pullConfig (benchmark::State& state) {
+    std::string path = tempPath("config.toml");
+    std::ofstream(path) << config_toml;
+    for (auto _ : state) {
+        HWconfig hw;
+        pullConfig(hw, path);
+        benchmark::DoNotOptimize(hw.pue);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_pullConfig);
+
+//a monitor start with the binary cache written by the previous one
+static void BM_pullConfigCached (benchmark::State& state) {
+    std::string path = tempPath("cached.toml");
+    std::ofstream(path) << config_toml;
+    HWconfig first;
+    pullConfig(first, path, true);
+    for (auto _ : state) {
+        HWconfig hw;
+        pullConfig(hw, path, true);
+        benchmark::DoNotOptimize(hw.pue);
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + CONFIG_CACHE_SUFFIX);
+}
+BENCHMARK(BM_pullConfigCached);
+
+//decoding alone, on a tree parsed once: the schema against the chained finds pullConfig used to do
+static void BM_decodeConfig (benchmark::State& state) {
+    std::istringstream in(config_toml);
+    toml::arena_scope arena;
+    const ConfigValue config = toml::parse<toml::compact_regions, toml::arena_map, toml::arena_vector>(in, "config");
+    for (auto _ : state) {
+        HWconfig hw;
+        benchmark::DoNotOptimize(decodeConfig(hw, config));
+        benchmark::DoNotOptimize(hw.pue);
+    }
+}
+BENCHMARK(BM_decodeConfig);
+
+static void BM_decodeConfigFind (benchmark::State& state) {
+    std::istringstream in(config_toml);
+    toml::arena_scope arena;
+    const ConfigValue config = toml::parse<toml::compact_regions, toml::arena_map, toml::arena_vector>(in, "config");
+    for (auto _ : state) {
+        HWconfig hw;
+        const auto& owner = toml::find(config, "owner");
+        hw.exp_name = toml::find<std::string>(owner, "title");
+        const auto& infra = toml::find(config, "infrastructure");
+        hw.root_folder = toml::find<std::string>(infra, "root_folder");
+        hw.cpu_stat_file = toml::find<std::string>(infra, "cpu_stat_file");
+        hw.mem_stat_file = toml::find<std::string>(infra, "mem_stat_file");
+        hw.arch = toml::find<std::string>(infra, "cpu_family");
+        hw.cpu_tdp = toml::find<int>(infra, "cpu_tdp");
+        hw.n_cpu = toml::find<int>(infra, "n_cpu");
+        hw.clock_ticks = toml::find<int>(infra, "clock_ticks");
+        hw.sampling_period_ms = toml::find_or<int>(infra, "sampling_period_ms", 0);
+        hw.sample_log = toml::find_or<std::string>(infra, "sample_log", "");
+        hw.sampler_threads = toml::find_or<int>(infra, "sampler_threads", 0);
+        hw.metrics = toml::find_or<std::string>(infra, "metrics", "");
+        const auto& energy = toml::find(config, "energy");
+        hw.carbon_intensity = toml::find<double>(energy, "carbon_intensity");
+        hw.pue = toml::find<double>(energy, "power_usage_efficiency");
+        hw.carbon_profile = toml::find_or<std::string>(energy, "carbon_profile", "");
+        hw.energy_source = toml::find_or<std::string>(energy, "source", "tdp");
+        hw.powercap_root = toml::find_or<std::string>(energy, "powercap_root", "/sys/class/powercap/");
+        hw.ram_family = toml::find<std::string>(infra, "ram_family");
+        hw.ram_freq = toml::find_or<int>(infra, "ram_freq", 0);
+        hw.ram_power_usage = toml::find_or<double>(infra, "ram_power_usage", dramPowerPerGB(hw.ram_family, 0));
+        hw.ram_model = toml::find_or<std::string>(energy, "ram_model", "fixed");
+        hw.cpu_idle_power = toml::find_or<double>(infra, "cpu_idle_power", 0.);
+        hw.cpufreq_root = toml::find_or<std::string>(infra, "cpufreq_root", "/sys/devices/system/cpu/");
+        benchmark::DoNotOptimize(hw.pue);
+    }
+}
+BENCHMARK(BM_decodeConfigFind);
+
+static void BM_makeReport (benchmark::State& state) {
+    HWconfig hw = pipelineConfig();
+    std::string records = tempPath("report.records");
+    for (auto _ : state) {
+        makeReport(hw, 3600., 42., records);
+    }
+    std::filesystem::remove(records);
+}
+BENCHMARK(BM_makeReport);
+
+static void BM_renderReport (benchmark::State& state) {
+    HWconfig hw = pipelineConfig();
+    std::string records = tempPath("render.records");
+    std::string report = tempPath("report.txt");
+    for (int i = 0; i < state.range(0); i++) {
+        makeReport(hw, 3600., 42., records);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(renderReport(records, report));
+    }
+    std::filesystem::remove(records);
+    std::filesystem::remove(report);
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_renderReport)->Range(1, 4096);
+
+static void BM_pipeline (benchmark::State& state) {
+    //two descriptors per PID: 10k PIDs need the file limit raised up to the hard limit
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    SyntheticSpec spec;
+    spec.n_pids = state.range(0);
+    spec.vm_wave_kb = 20000;
+    SyntheticProc tree(spec);
+    HWconfig hw = tree.config();
+    Sampler sampler(hw, tree.pids());
+    EnergyAccumulator acc(hw);
+    if (sampler.tick() != tree.size()) {
+        state.SkipWithError("cannot open every PID, raise the open files limit");
+        return;
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        tree.advance(1.);
+        state.ResumeTiming();
+        sampler.tick();
+        CPUreading r{sampler.totalIntervalUsage(hw), sampler.totalUsage(hw), sampler.interval()};
+        acc.push(sampler.up_time(), r, sampler.totalVmSize()/1000000);
+    }
+    benchmark::DoNotOptimize(acc.footprint());
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_pipeline)->Arg(1)->Arg(100)->Arg(10000)->Unit(benchmark::kMicrosecond);
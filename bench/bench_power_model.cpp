@@ -0,0 +1,85 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Per-sample cost of each power model policy, called on the
+ *  concrete ModelSource (inlined) and through EnergySource&
+ *  as EnergyAccumulator does. CoreFrequency reads the cpufreq
+ *  files of this machine, if any.
+ *
+ * ------------------------------------------------------------*/
+
+static HWconfig modelConfig () {
+    HWconfig hw;
+    hw.n_cpu = 2;
+    hw.cpu_tdp = 10;
+    hw.cpu_idle_power = 2;
+    hw.ram_power_usage = 0.375;
+    hw.ram_family = "DDR4";
+    hw.ram_freq = 3200;
+    hw.pue = 1.5;
+    hw.carbon_intensity = 100;
+    hw.cpufreq_root = "/sys/devices/system/cpu/";
+    return hw;
+}
+
+template <typename Cpu, typename Ram>
+static void BM_ModelSource (benchmark::State& state) {
+    HWconfig hw = modelConfig();
+    ModelSource<Cpu, Ram> model(hw);
+    CPUreading r{0.5, 0.5, 1.};
+    double mem_gb = 2.;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r);
+        benchmark::DoNotOptimize(model.power(r, mem_gb));
+    }
+}
+BENCHMARK_TEMPLATE(BM_ModelSource, TdpLinear, RamPerGB);
+BENCHMARK_TEMPLATE(BM_ModelSource, TdpIdleFloor, RamPerGB);
+BENCHMARK_TEMPLATE(BM_ModelSource, CoreFrequency, RamPerGB);
+BENCHMARK_TEMPLATE(BM_ModelSource, TdpLinear, DramFamily);
+
+static void BM_makeEnergySource_virtual (benchmark::State& state, const char* source, const char* ram_model) {
+    HWconfig hw = modelConfig();
+    hw.energy_source = source;
+    hw.ram_model = ram_model;
+    auto model = makeEnergySource(hw);
+    EnergySource& s = *model;
+    CPUreading r{0.5, 0.5, 1.};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r);
+        benchmark::DoNotOptimize(s.power(r, 2.));
+    }
+}
+BENCHMARK_CAPTURE(BM_makeEnergySource_virtual, tdp, "tdp", "fixed");
+BENCHMARK_CAPTURE(BM_makeEnergySource_virtual, tdp_idle, "tdp_idle", "fixed");
+BENCHMARK_CAPTURE(BM_makeEnergySource_virtual, frequency, "frequency", "fixed");
+BENCHMARK_CAPTURE(BM_makeEnergySource_virtual, tdp_family, "tdp", "family");
+
+//EnergyAccumulator::push with the source called through EnergySource& or on its concrete type
+static void BM_EnergyAccumulator_source (benchmark::State& state, const char* source, bool visited) {
+    HWconfig hw = modelConfig();
+    hw.energy_source = source;
+    hw.ram_model = "family";
+    auto model = makeEnergySource(hw);
+    EnergyAccumulator acc(hw, *model);
+    CPUreading r{0.5, 0.5, 1.};
+    double t = 0;
+    if (visited) {
+        visitEnergySource(*model, [&] (auto& power) {
+            for (auto _ : state) {
+                acc.push(t += 1., r, 2., power);
+            }
+        });
+    } else {
+        for (auto _ : state) {
+            acc.push(t += 1., r, 2.);
+        }
+    }
+    benchmark::DoNotOptimize(acc.joules());
+}
+BENCHMARK_CAPTURE(BM_EnergyAccumulator_source, tdp_virtual, "tdp", false);
+BENCHMARK_CAPTURE(BM_EnergyAccumulator_source, tdp_visited, "tdp", true);
+BENCHMARK_CAPTURE(BM_EnergyAccumulator_source, tdp_idle_virtual, "tdp_idle", false);
+BENCHMARK_CAPTURE(BM_EnergyAccumulator_source, tdp_idle_visited, "tdp_idle", true);
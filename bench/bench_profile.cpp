@@ -0,0 +1,63 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Carbon intensity profiles: loading a million-row CSV and
+ *  the per-sample lookup cost, cursor against binary search.
+ *
+ * ------------------------------------------------------------*/
+
+static const std::size_t profile_rows = 1000000;
+
+static std::vector<std::pair<double, double>> hourlyRows () {
+    std::vector<std::pair<double, double>> rows(profile_rows);
+    for (std::size_t i = 0; i < profile_rows; i++) {
+        rows[i] = {1.6e9 + 3600.*i, 100. + static_cast<double>(i%24)*10.};
+    }
+    return rows;
+}
+
+static void BM_CarbonProfile_load (benchmark::State& state) {
+    std::string path = (std::filesystem::temp_directory_path() / "kig_bench_profile.csv").string();
+    {
+        std::ofstream out(path);
+        out << "timestamp,intensity" << '\n';
+        for (const auto& row : hourlyRows()) {
+            out << std::fixed << row.first << ',' << row.second << '\n';
+        }
+    }
+    for (auto _ : state) {
+        CarbonProfile profile;
+        profile.load(path);
+        benchmark::DoNotOptimize(profile.size());
+    }
+    state.SetItemsProcessed(state.iterations()*profile_rows);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_CarbonProfile_load)->Unit(benchmark::kMillisecond);
+
+static void BM_CarbonProfile_binarySearch (benchmark::State& state) {
+    CarbonProfile profile;
+    profile.assign(hourlyRows());
+    double t = 1.6e9;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(profile.intensity(t));
+        t += 10.;                                       //a sample every 10 s
+    }
+}
+BENCHMARK(BM_CarbonProfile_binarySearch);
+
+static void BM_CarbonProfile_cursor (benchmark::State& state) {
+    CarbonProfile profile;
+    profile.assign(hourlyRows());
+    std::size_t cursor = 0;
+    double t = 1.6e9;
+    double t0 = t;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(profile.integral(t0, t, cursor));
+        t0 = t;
+        t += 10.;
+    }
+}
+BENCHMARK(BM_CarbonProfile_cursor);
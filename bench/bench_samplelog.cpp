@@ -0,0 +1,46 @@
+#include <KIG.h>
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Sample log: per-sample write overhead (to be compared with
+ *  the 100 us budget of a 10 kHz aggregate sample rate) and
+ *  read-back throughput through the mmap reader.
+ *
+ * ------------------------------------------------------------*/
+
+static std::string logPath () {
+    return (std::filesystem::temp_directory_path() / ("kig_bench_" + std::to_string(getpid()) + ".log")).string();
+}
+
+static void BM_SampleLog_push (benchmark::State& state) {
+    std::string path = logPath();
+    {
+        SampleLog log(path, static_cast<std::size_t>(state.range(0)));
+        double t = 0;
+        for (auto _ : state) {
+            log.push(t, 4242, 1234, 567, 2048, 12.5);
+            t += 1e-4;                                          //10 kHz
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_SampleLog_push)->Arg(256)->Arg(4096)->Arg(65536);
+
+static void BM_SampleLogReader_joules (benchmark::State& state) {
+    std::string path = logPath();
+    {
+        SampleLog log(path);
+        for (int i = 0; i < state.range(0); i++) {
+            log.push(i*1e-4, 4242 + i%100, i, i, 2048, 12.5);
+        }
+    }
+    for (auto _ : state) {
+        SampleLogReader reader(path);
+        benchmark::DoNotOptimize(reader.joules());
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_SampleLogReader_joules)->Arg(1 << 20);
@@ -0,0 +1,65 @@
+#include "synthetic_proc.h"
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Multi-PID sampling: one Sampler::tick() against the
+ *  per-PID ProcHandle + sysinfo() loop, and the cost of the
+ *  aggregation passes over the structure of arrays, on a
+ *  synthetic /proc tree (SyntheticProc) of 16384 PIDs.
+ *
+ * ------------------------------------------------------------*/
+
+static const SyntheticProc& procTree () {
+    static const SyntheticProc tree([] { SyntheticSpec spec; spec.n_pids = 16384; return spec; }());
+    return tree;
+}
+
+static std::vector<pid_t> firstPids (std::size_t n) {
+    const auto& pids = procTree().pids();
+    return std::vector<pid_t>(std::begin(pids), std::begin(pids) + n);
+}
+
+static void BM_ProcHandle_loop (benchmark::State& state) {
+    HWconfig hw = procTree().config();
+    std::vector<ProcHandle> handles;
+    for (pid_t pid : firstPids(state.range(0))) {
+        handles.emplace_back(hw, pid);
+    }
+    CPUsage c;
+    struct sysinfo T;
+    for (auto _ : state) {
+        for (auto& handle : handles) {
+            handle.sample(c);
+            sysinfo(&T);
+            c.up_time = T.uptime;
+            benchmark::DoNotOptimize(c);
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_ProcHandle_loop)->Range(1, 256);
+
+static void BM_Sampler_tick (benchmark::State& state) {
+    HWconfig hw = procTree().config();
+    Sampler sampler(hw, firstPids(state.range(0)));
+    for (auto _ : state) {
+        sampler.tick();
+        benchmark::DoNotOptimize(sampler.totalUsage(hw));
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_Sampler_tick)->Range(1, 256);
+
+static void BM_Sampler_aggregate (benchmark::State& state) {
+    HWconfig hw = procTree().config();
+    Sampler sampler(hw, firstPids(state.range(0)));
+    sampler.tick();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sampler.totalTicks());
+        benchmark::DoNotOptimize(sampler.totalVmSize());
+        benchmark::DoNotOptimize(sampler.totalUsage(hw));
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_Sampler_aggregate)->Range(64, 16384);
@@ -0,0 +1,30 @@
+#include "synthetic_proc.h"
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  Scaling of ShardedSampler::tick() from 1 to 64 worker
+ *  threads on a synthetic /proc tree (SyntheticProc) of 4096
+ *  PIDs, advanced by one second between two ticks.
+ *
+ * ------------------------------------------------------------*/
+
+static const int n_pids = 4096;
+
+static void BM_ShardedSampler_tick (benchmark::State& state) {
+    SyntheticSpec spec;
+    spec.n_pids = n_pids;
+    SyntheticProc tree(spec);
+    HWconfig hw = tree.config();
+    ShardedSampler sampler(hw, tree.pids(), state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        tree.advance(1.);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(sampler.tick());
+        benchmark::DoNotOptimize(sampler.totalIntervalUsage());
+    }
+    state.SetItemsProcessed(state.iterations()*n_pids);
+    state.counters["shards"] = sampler.shards();
+}
+BENCHMARK(BM_ShardedSampler_tick)->RangeMultiplier(2)->Range(1, 64)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,78 @@
+#include "synthetic_proc.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+/*-------------------------------------------------------------
+ *
+ *  /proc/<pid>/stat parsing: fillBuffer() + update() against
+ *  the allocation-free readStat()/parseStat() path, and
+ *  path-based reads against a persistent ProcHandle, on a
+ *  synthetic process (SyntheticProc).
+ *
+ * ------------------------------------------------------------*/
+
+static const SyntheticProc proc_tree([] { SyntheticSpec spec; spec.n_pids = 1; return spec; }());
+static const std::string self_stat = proc_tree.path(0, "/stat");
+
+//a comm field with spaces and parentheses, as produced by e.g. prctl(PR_SET_NAME)
+static const char tricky_stat[] =
+    "4242 (my (odd) job) S 1 4242 4242 0 -1 4194560 1520 0 0 0 "
+    "1234 567 0 0 20 0 8 0 98765 123456789 2048 18446744073709551615 "
+    "1 1 0 0 0 0 0 0 0 0 0 0 17 3 0 0 0 0 0\n";
+
+static void BM_fillBuffer_update (benchmark::State& state) {
+    CPUsage c;
+    struct sysinfo T;
+    std::vector<std::string> v;
+    for (auto _ : state) {
+        fillBuffer(v, self_stat);
+        update(c, v, T);
+        flushBuffer(v);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_fillBuffer_update);
+
+static void BM_readStat (benchmark::State& state) {
+    CPUsage c;
+    struct sysinfo T;
+    for (auto _ : state) {
+        readStat(c, self_stat);
+        sysinfo(&T);
+        c.up_time = T.uptime;
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_readStat);
+
+static void BM_parseStat (benchmark::State& state) {
+    CPUsage c;
+    for (auto _ : state) {
+        bool ok = parseStat(c, tricky_stat, std::strlen(tricky_stat));
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_parseStat);
+
+static void BM_readStat_fetchMem (benchmark::State& state) {
+    CPUsage c;
+    std::string pid = std::to_string(proc_tree.pids()[0]);
+    for (auto _ : state) {
+        readStat(c, proc_tree.root() + pid + "/stat");
+        c.vm_size = fetchMem(proc_tree.root() + pid + "/status");
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_readStat_fetchMem);
+
+static void BM_ProcHandle_sample (benchmark::State& state) {
+    HWconfig hw = proc_tree.config();
+    ProcHandle handle(hw, proc_tree.pids()[0]);
+    CPUsage c;
+    for (auto _ : state) {
+        handle.sample(c);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_ProcHandle_sample);
@@ -0,0 +1,62 @@
+#include "synthetic_proc.h"
+#include <benchmark/benchmark.h>
+
+/*-------------------------------------------------------------
+ *
+ *  /proc/<pid>/status parsing: the former line-skipping
+ *  istream reader against the key-scanning fetchStatus(), on
+ *  a synthetic process (SyntheticProc) with a 6.x kernel layout.
+ *
+ * ------------------------------------------------------------*/
+
+static const SyntheticProc proc_tree([] { SyntheticSpec spec; spec.n_pids = 1; return spec; }());
+static const std::string self_status = proc_tree.path(0, "/status");
+
+//fetchMem() as it was before fetchStatus(): skips 17 lines, then tokenises line 18.
+static double fetchMemIstream (std::string PATH_MEM) {
+    std::ifstream memstat(PATH_MEM);
+    std::string mem;
+    for (int i=0; i<17; i++) {
+        memstat.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    std::getline(memstat, mem);
+
+    std::stringstream s (mem);
+    std::string temp;
+    double vmsize = 0;
+    while (!s.eof()) {
+        s >> temp;
+        if (std::stringstream(temp) >> vmsize) {
+                vmsize = vmsize/1000000;
+                break;
+        }
+    }
+    return vmsize;
+}
+
+static void BM_fetchMem_istream (benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fetchMemIstream(self_status));
+    }
+}
+BENCHMARK(BM_fetchMem_istream);
+
+static void BM_fetchStatus (benchmark::State& state) {
+    for (auto _ : state) {
+        MemStatus m = fetchStatus(self_status);
+        benchmark::DoNotOptimize(m);
+    }
+}
+BENCHMARK(BM_fetchStatus);
+
+static void BM_parseStatus (benchmark::State& state) {
+    std::ifstream in(self_status);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    MemStatus m;
+    for (auto _ : state) {
+        bool ok = parseStatus(m, content.data(), content.size());
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(m);
+    }
+}
+BENCHMARK(BM_parseStatus);
@@ -0,0 +1,63 @@
+#include "synthetic_proc.h"
+
+/*-------------------------------------------------------------
+ *
+ *  Writes a synthetic /proc tree and replays it in real time,
+ *  advancing it once per period, so that KIG_ex (with
+ *  root_folder pointing to the tree) or any other reader can
+ *  be run against a reproducible load:
+ *
+ *    kig_synthproc <root> <n_pids> [period_ms] [duration_s]
+ *    kig_synthproc --snapshot <root> <period_ms> <duration_s> <pid>...
+ *
+ *  The PIDs of the tree are printed on the first line.
+ *
+ * ------------------------------------------------------------*/
+
+int main (int argc, char** argv) {
+    bool snapshot = argc >= 6 && std::string(argv[1]) == "--snapshot";
+    if (!snapshot && argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <root> <n_pids> [period_ms] [duration_s]" << '\n';
+        std::cerr << "       " << argv[0] << " --snapshot <root> <period_ms> <duration_s> <pid>..." << '\n';
+        return 1;
+    }
+
+    SyntheticSpec spec;
+    std::unique_ptr<SyntheticProc> tree;
+    double period_ms = 1000;
+    double duration = 60;
+    try {
+        if (snapshot) {
+            period_ms = std::stod(argv[3]);
+            duration = std::stod(argv[4]);
+            std::vector<pid_t> pids;
+            for (int i = 5; i < argc; i++) {
+                pids.push_back(std::stoi(argv[i]));
+            }
+            tree = std::make_unique<SyntheticProc>(pids, spec, argv[2]);
+        }
+        else {
+            spec.n_pids = std::stoul(argv[2]);
+            spec.vm_wave_kb = 20000;
+            if (argc > 3) period_ms = std::stod(argv[3]);
+            if (argc > 4) duration = std::stod(argv[4]);
+            tree = std::make_unique<SyntheticProc>(spec, argv[1]);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return 1;
+    }
+
+    for (pid_t pid : tree->pids()) {
+        std::cout << pid << ' ';
+    }
+    std::cout << std::endl;
+
+    Scheduler sched(period_ms);
+    while (tree->time() < duration) {
+        sched.wait();
+        tree->advance(period_ms*1e-3);
+    }
+    return 0;
+}
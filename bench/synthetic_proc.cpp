@@ -0,0 +1,235 @@
+#include "synthetic_proc.h"
+#include <cmath>
+#include <iomanip>
+
+//written in every tree: a folder without it is never wiped
+static const char* const TREE_MARKER = ".kig_synthetic_proc";
+
+/*!
+ *  @brief
+ *  This function synthesises a tree of spec.n_pids processes.
+ *
+ *  @param[in] spec: The shape of the tree
+ *  @param[in] root: The folder of the tree, a new folder under /dev/shm (or the temporary
+ *                   folder) if empty. It must be missing, empty or a tree written by a
+ *                   SyntheticProc, which is wiped; otherwise std::runtime_error is thrown.
+ */
+SyntheticProc::SyntheticProc (const SyntheticSpec& spec, const std::string& root)
+    : spec(spec), now(0), owned(true) {
+    std::mt19937 gen(spec.seed);
+    std::uniform_real_distribution<double> unit(0., 1.);
+    unsigned long long boot = static_cast<unsigned long long>(upTime()*spec.clock_ticks);
+
+    for (std::size_t i = 0; i < spec.n_pids; i++) {
+        Proc p;
+        p.comm = "worker_" + std::to_string(i);
+        p.usage = std::min(1., 2*spec.cpu_usage*unit(gen));
+        double age = 1 + 3600*unit(gen);                                    //s
+        p.utime = p.usage*(1 - spec.system_share)*age*spec.clock_ticks;
+        p.stime = p.usage*spec.system_share*age*spec.clock_ticks;
+        p.starttime = boot - std::min(boot, static_cast<unsigned long long>(age*spec.clock_ticks));
+        p.vm_base = spec.vm_size_kb*(0.5 + unit(gen));
+        p.phase = 2*M_PI*unit(gen);
+        p.threads = 1 + static_cast<long>(8*unit(gen));
+        p.alive = true;
+        procs.push_back(p);
+        pid_list.push_back(spec.first_pid + static_cast<pid_t>(i));
+    }
+    setUp(root);
+}
+
+/*!
+ *  @brief
+ *  This function snapshots the stat and status of live processes, then lets them evolve as
+ *  described by spec (CPU usage and memory curves; n_pids and first_pid are ignored).
+ *
+ *  @param[in] live: The PIDs to snapshot. Those that cannot be read are skipped.
+ *  @param[in] spec: The evolution of the tree
+ *  @param[in] root: As for the synthesising constructor
+ *
+ *  @details
+ *  The processes keep their PIDs, counters and memory; the CPU usage of each one is its
+ *  lifetime usage at the time of the snapshot. The counters are in the ticks of /proc, so
+ *  spec.clock_ticks must be left to its default, sysconf(_SC_CLK_TCK).
+ */
+SyntheticProc::SyntheticProc (const std::vector<pid_t>& live, const SyntheticSpec& spec, const std::string& root)
+    : spec(spec), now(0), owned(true) {
+    HWconfig hw;
+    hw.root_folder = "/proc/";
+    hw.cpu_stat_file = "/stat";
+    hw.mem_stat_file = "/status";
+    double up = upTime();
+
+    for (pid_t pid : live) {
+        ProcHandle handle(hw, pid);
+        CPUsage c;
+        MemStatus m;
+        if (!handle.sample(c, m)) {
+            continue;
+        }
+        std::ifstream comm("/proc/" + std::to_string(pid) + "/comm");
+        Proc p;
+        std::getline(comm, p.comm);
+        double age = up - static_cast<double>(c.starttime)/spec.clock_ticks;
+        p.utime = static_cast<double>(c.utime);
+        p.stime = static_cast<double>(c.stime);
+        p.usage = (age > 0) ? std::min(1., (p.utime + p.stime)/spec.clock_ticks/age) : 0.;
+        p.starttime = c.starttime;
+        p.vm_base = static_cast<double>(m.vm_size);
+        p.phase = 0;
+        p.threads = m.threads;
+        p.alive = true;
+        procs.push_back(p);
+        pid_list.push_back(pid);
+    }
+    setUp(root);
+}
+
+SyntheticProc::~SyntheticProc () {
+    if (owned && std::filesystem::exists(folder + TREE_MARKER)) {
+        std::error_code ec;
+        std::filesystem::remove_all(folder, ec);
+    }
+}
+
+void SyntheticProc::setUp (const std::string& root) {
+    if (root.empty()) {
+        std::filesystem::path base = std::filesystem::is_directory("/dev/shm") ?
+            std::filesystem::path("/dev/shm") : std::filesystem::temp_directory_path();
+        static std::atomic<int> n_trees(0);
+        folder = (base / ("kig_proc_" + std::to_string(getpid()) + "_" + std::to_string(n_trees++))).string() + "/";
+    }
+    else {
+        folder = (root.back() == '/') ? root : root + "/";
+    }
+    if (std::filesystem::exists(folder + TREE_MARKER)) {
+        std::filesystem::remove_all(folder);
+    }
+    else if (std::filesystem::exists(folder) &&
+             (!std::filesystem::is_directory(folder) || !std::filesystem::is_empty(folder))) {
+        throw std::runtime_error("not a synthetic /proc tree, refusing to wipe " + folder);
+    }
+    std::filesystem::create_directories(folder);
+    std::ofstream(folder + TREE_MARKER) << "written by SyntheticProc, removed with this folder\n";
+    for (std::size_t i = 0; i < procs.size(); i++) {
+        std::filesystem::create_directories(folder + std::to_string(pid_list[i]));
+        write(i);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns an HWconfig reading the tree: root_folder, stat and status files,
+ *  clock_ticks, and a single CPU.
+ */
+HWconfig SyntheticProc::config () const {
+    HWconfig hw;
+    hw.root_folder = folder;
+    hw.cpu_stat_file = "/stat";
+    hw.mem_stat_file = "/status";
+    hw.clock_ticks = spec.clock_ticks;
+    hw.n_cpu = 1;
+    hw.cpu_tdp = 10;
+    hw.ram_power_usage = 0.375;
+    hw.pue = 1;
+    hw.carbon_intensity = 100;
+    return hw;
+}
+
+long SyntheticProc::vmSize (const Proc& p) const {
+    double vm = p.vm_base + spec.vm_growth_kb*now + spec.vm_wave_kb*std::sin(2*M_PI*now/spec.vm_wave_period + p.phase);
+    return std::max(0L, static_cast<long>(vm));
+}
+
+/*!
+ *  @brief
+ *  This function moves the clock of the tree dt seconds forward: every live process consumes
+ *  usage * dt seconds of CPU and its memory follows the curves of the spec.
+ *
+ *  @param[in] dt: The time step, in seconds
+ */
+void SyntheticProc::advance (double dt) {
+    now += dt;
+    for (std::size_t i = 0; i < procs.size(); i++) {
+        Proc& p = procs[i];
+        if (!p.alive) {
+            continue;
+        }
+        p.utime += p.usage*(1 - spec.system_share)*dt*spec.clock_ticks;
+        p.stime += p.usage*spec.system_share*dt*spec.clock_ticks;
+        write(i);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function terminates the process in slot i: its files are emptied, which readers see as
+ *  a process that has exited, and advance() stops updating it.
+ */
+void SyntheticProc::retire (std::size_t i) {
+    procs[i].alive = false;
+    std::string dir = folder + std::to_string(pid_list[i]);
+    std::filesystem::resize_file(dir + "/stat", 0);
+    std::filesystem::resize_file(dir + "/status", 0);
+}
+
+//overwrites the file in place, then cuts the stale tail: a concurrent pread never sees it empty
+static void rewrite (const std::string& path, const std::string& content) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    std::size_t done = 0;
+    while (done < content.size()) {
+        ssize_t n = pwrite(fd, content.data() + done, content.size() - done, static_cast<off_t>(done));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    if (done == content.size()) {
+        int r = ftruncate(fd, static_cast<off_t>(done));
+        (void)r;
+    }
+    close(fd);
+}
+
+void SyntheticProc::write (std::size_t i) const {
+    const Proc& p = procs[i];
+    pid_t pid = pid_list[i];
+    std::string dir = folder + std::to_string(pid);
+    long vm = vmSize(p);
+    long rss_kb = vm/10;
+    long page_kb = 4;
+
+    std::ostringstream stat;
+    stat << pid << " (" << p.comm << ") R 1 " << pid << ' ' << pid << " 0 -1 4194560 1520 0 0 0 "
+         << static_cast<unsigned long long>(p.utime) << ' ' << static_cast<unsigned long long>(p.stime)
+         << " 0 0 20 0 " << p.threads << " 0 " << p.starttime << ' ' << vm*1024 << ' ' << rss_kb/page_kb
+         << " 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 3 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+    rewrite(dir + "/stat", stat.str());
+
+    //same lines, in the same order, as a 6.x kernel
+    std::ostringstream status;
+    status << "Name:\t" << p.comm << "\nUmask:\t0022\nState:\tR (running)\nTgid:\t" << pid << "\nNgid:\t0\nPid:\t" << pid
+           << "\nPPid:\t1\nTracerPid:\t0\nUid:\t1000\t1000\t1000\t1000\nGid:\t1000\t1000\t1000\t1000\nFDSize:\t64\n"
+           << "Groups:\t1000 \nNStgid:\t" << pid << "\nNSpid:\t" << pid << "\nNSpgid:\t" << pid << "\nNSsid:\t" << pid
+           << "\nVmPeak:\t" << std::setw(8) << vm + 1024 << " kB\nVmSize:\t" << std::setw(8) << vm
+           << " kB\nVmLck:\t       0 kB\nVmPin:\t       0 kB\nVmHWM:\t" << std::setw(8) << rss_kb + 512
+           << " kB\nVmRSS:\t" << std::setw(8) << rss_kb << " kB\nRssAnon:\t" << std::setw(8) << rss_kb*3/4
+           << " kB\nRssFile:\t" << std::setw(8) << rss_kb - rss_kb*3/4 << " kB\nRssShmem:\t       0 kB\n"
+           << "VmData:\t" << std::setw(8) << vm/2 << " kB\nVmStk:\t     132 kB\nVmExe:\t     800 kB\n"
+           << "VmLib:\t    2000 kB\nVmPTE:\t     120 kB\nVmSwap:\t       0 kB\nHugetlbPages:\t       0 kB\n"
+           << "CoreDumping:\t0\nTHP_enabled:\t1\nThreads:\t" << p.threads << "\nSigQ:\t0/63712\n"
+           << "SigPnd:\t0000000000000000\nShdPnd:\t0000000000000000\nSigBlk:\t0000000000000000\n"
+           << "SigIgn:\t0000000000001000\nSigCgt:\t0000000000000000\nCapInh:\t0000000000000000\n"
+           << "CapPrm:\t0000000000000000\nCapEff:\t0000000000000000\nCapBnd:\t000001ffffffffff\n"
+           << "CapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\nSeccomp_filters:\t0\n"
+           << "Speculation_Store_Bypass:\tthread vulnerable\nSpeculationIndirectBranch:\tconditional enabled\n"
+           << "Cpus_allowed:\tff\nCpus_allowed_list:\t0-7\nMems_allowed:\t00000001\nMems_allowed_list:\t0\n"
+           << "voluntary_ctxt_switches:\t10\nnonvoluntary_ctxt_switches:\t2\n";
+    rewrite(dir + "/status", status.str());
+}
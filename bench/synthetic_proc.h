@@ -0,0 +1,86 @@
+/**
+ * @file
+*/
+
+#ifndef SYNTHETIC_PROC_H
+#define SYNTHETIC_PROC_H
+
+#include <KIG.h>
+#include <random>
+
+/**
+ *  @brief The shape of a synthetic /proc tree: how many PIDs, how busy they are and how their
+ *  memory evolves. Per-PID values are drawn from a generator seeded with seed, so the same spec
+ *  always produces the same tree.
+*/
+struct SyntheticSpec {
+
+    std::size_t n_pids = 1024;                      /**< Number of processes                          */
+    pid_t first_pid = 100000;                       /**< PID of the first process, the others follow  */
+    int clock_ticks = static_cast<int>(sysconf(_SC_CLK_TCK));   /**< Ticks per second of utime and stime, those of /proc by default, as snapshots read it */
+    double cpu_usage = 0.5;                         /**< Mean CPU usage factor, per process in [0, 1] */
+    double system_share = 0.1;                      /**< Share of the CPU time spent in stime         */
+    double vm_size_kb = 100000;                     /**< Mean VmSize at time 0                        */
+    double vm_growth_kb = 0;                        /**< VmSize growth, kB per second                 */
+    double vm_wave_kb = 0;                          /**< Amplitude of a periodic VmSize oscillation   */
+    double vm_wave_period = 60;                     /**< Period of the oscillation, in seconds        */
+    unsigned seed = 42;                             /**< Seed of the per-process draws                */
+
+};
+
+/**
+ *  @brief A synthetic /proc tree: <root>/<pid>/stat and <root>/<pid>/status files in the kernel
+ *  formats, readable by every parser of KIG through config().
+ *
+ *  The tree is synthesised from a SyntheticSpec, or snapshotted from live processes and then
+ *  evolved with the spec. advance() is the replay driver: it moves the clock of the tree forward
+ *  and rewrites every file in place, so that ProcHandles keeping the files open read the new
+ *  values, as they would with /proc. retire() makes a process disappear for its readers. The
+ *  folder is created under /dev/shm (tmpfs) when available and removed on destruction; a marker
+ *  file in it tells a tree apart from any other folder, which is never wiped.
+*/
+class SyntheticProc {
+public:
+    explicit SyntheticProc (const SyntheticSpec&, const std::string& = "");
+    SyntheticProc (const std::vector<pid_t>&, const SyntheticSpec&, const std::string& = "");
+    SyntheticProc (const SyntheticProc&) = delete;
+    SyntheticProc& operator= (const SyntheticProc&) = delete;
+    ~SyntheticProc ();
+
+    void advance (double);
+    void retire (std::size_t);
+    void keep () { owned = false; }
+
+    const std::string& root () const { return folder; }
+    const std::vector<pid_t>& pids () const { return pid_list; }
+    std::size_t size () const { return procs.size(); }
+    double time () const { return now; }
+    std::string path (std::size_t slot, const std::string& file) const { return folder + std::to_string(pid_list[slot]) + file; }
+    HWconfig config () const;
+
+private:
+    struct Proc {
+        std::string comm;
+        double usage;                               //CPU usage factor
+        double utime;                               //ticks
+        double stime;                               //ticks
+        unsigned long long starttime;               //ticks
+        double vm_base;                             //kB
+        double phase;
+        long threads;
+        bool alive;
+    };
+
+    void setUp (const std::string&);
+    void write (std::size_t) const;
+    long vmSize (const Proc&) const;
+
+    SyntheticSpec spec;
+    std::string folder;
+    std::vector<pid_t> pid_list;
+    std::vector<Proc> procs;
+    double now;
+    bool owned;
+};
+
+#endif
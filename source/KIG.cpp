@@ -3,6 +3,331 @@
  *  FUNCTION DEFINITIONS:                                             *
   ################################################################### */
 
+template <typename T>
+static const char* positive (const T& v) { return (v > 0) ? nullptr : "must be > 0"; }
+
+template <typename T>
+static const char* notNegative (const T& v) { return (v >= 0) ? nullptr : "must be >= 0"; }
+
+static const char* notEmpty (const std::string& v) { return v.empty() ? "must not be empty" : nullptr; }
+
+static const char* atLeastOne (const double& v) { return (v >= 1) ? nullptr : "must be >= 1"; }
+
+//where each HWconfig field lives in the configuration file. profile is loaded from carbon_profile.
+static constexpr ConfigSchema hwSchema(
+    requiredField("owner", "title", &HWconfig::exp_name),
+
+    requiredField("infrastructure", "root_folder", &HWconfig::root_folder, notEmpty),
+    requiredField("infrastructure", "cpu_stat_file", &HWconfig::cpu_stat_file, notEmpty),
+    requiredField("infrastructure", "mem_stat_file", &HWconfig::mem_stat_file, notEmpty),
+    requiredField("infrastructure", "cpu_family", &HWconfig::arch),
+    requiredField("infrastructure", "cpu_tdp", &HWconfig::cpu_tdp, positive<int>),
+    requiredField("infrastructure", "n_cpu", &HWconfig::n_cpu, positive<int>),
+    requiredField("infrastructure", "clock_ticks", &HWconfig::clock_ticks, positive<int>),
+    optionalField("infrastructure", "sampling_period_ms", &HWconfig::sampling_period_ms,
+                  [] (const HWconfig&) { return 0; }, notNegative<int>),
+    optionalField("infrastructure", "sample_log", &HWconfig::sample_log,
+                  [] (const HWconfig&) { return std::string(); }),
+    optionalField("infrastructure", "sampler_threads", &HWconfig::sampler_threads,
+                  [] (const HWconfig&) { return 0; }, notNegative<int>),
+    optionalField("infrastructure", "metrics", &HWconfig::metrics,
+                  [] (const HWconfig&) { return std::string(); }),
+    requiredField("infrastructure", "ram_family", &HWconfig::ram_family),
+    optionalField("infrastructure", "ram_freq", &HWconfig::ram_freq,
+                  [] (const HWconfig&) { return 0; }, notNegative<int>),
+    //per-GB. Replaces ram_size, no longer read: ram_size = 1 with ram_family = "COMMON" used to select 0.375
+    optionalField("infrastructure", "ram_power_usage", &HWconfig::ram_power_usage,
+                  [] (const HWconfig& hw) { return dramPowerPerGB(hw.ram_family, hw.ram_freq); }, notNegative<double>),
+    optionalField("infrastructure", "cpu_idle_power", &HWconfig::cpu_idle_power,
+                  [] (const HWconfig&) { return 0.; }, notNegative<double>),
+    optionalField("infrastructure", "cpufreq_root", &HWconfig::cpufreq_root,
+                  [] (const HWconfig&) { return std::string("/sys/devices/system/cpu/"); }),
+
+    requiredField("energy", "carbon_intensity", &HWconfig::carbon_intensity, notNegative<double>),
+    requiredField("energy", "power_usage_efficiency", &HWconfig::pue, atLeastOne),
+    optionalField("energy", "carbon_profile", &HWconfig::carbon_profile,
+                  [] (const HWconfig&) { return std::string(); }),
+    optionalField("energy", "source", &HWconfig::energy_source,
+                  [] (const HWconfig&) { return std::string("tdp"); }),
+    optionalField("energy", "powercap_root", &HWconfig::powercap_root,
+                  [] (const HWconfig&) { return std::string("/sys/class/powercap/"); }),
+    optionalField("energy", "ram_model", &HWconfig::ram_model,
+                  [] (const HWconfig&) { return std::string("fixed"); })
+);
+
+/*
+ * The binary configuration cache: a ConfigCacheHeader, then the payload, i.e. the fields of
+ * hwSchema in its order (int as 4 bytes, double as 8 bytes, string as a 4-byte length and its
+ * bytes), a flag byte and, if it is 1, the CarbonProfile. Values are in the byte order of the
+ * host. The header keys the image to the TOML file it was written from (size, mtime and a hash
+ * of the content) and to the carbon profile (size and mtime), and fingerprints the schema, so an
+ * image of another file, of an edited file or of another KIG version is never loaded.
+ */
+struct ConfigCacheHeader {
+    char magic[8];
+    std::uint64_t schema;                           //hash of the tables, keys and types of hwSchema
+    std::uint64_t toml_size;
+    std::int64_t toml_mtime;                        //in ns
+    std::uint64_t toml_hash;
+    std::uint64_t profile_size;                     //0 when there is no carbon profile
+    std::int64_t profile_mtime;
+    std::uint64_t payload_size;
+    std::uint64_t payload_hash;
+};
+
+//64-bit FNV-1a over 8-byte words, then over the last bytes
+static std::uint64_t imageHash (const char* p, std::size_t n, std::uint64_t h = 14695981039346656037ull) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for (; i < n; i++) {
+        h = (h ^ static_cast<unsigned char>(p[i])) * 1099511628211ull;
+    }
+    return h;
+}
+
+static char typeTag (const int&) { return 'i'; }
+static char typeTag (const double&) { return 'd'; }
+static char typeTag (const std::string&) { return 's'; }
+
+static std::uint64_t schemaHash () {
+    static const std::uint64_t h = [] {
+        std::string s = CONFIG_CACHE_MAGIC;
+        HWconfig hw;
+        hwSchema.visit([&] (const auto& f) {
+            s.append(f.table).append(".").append(f.key).append(":").push_back(typeTag(hw.*f.member));
+            s.push_back('\n');
+        });
+        return imageHash(s.data(), s.size());
+    }();
+    return h;
+}
+
+static void putValue (std::string& out, int v) {
+    std::int32_t x = v;
+    out.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+static void putValue (std::string& out, double v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static void putValue (std::string& out, const std::string& v) {
+    std::uint32_t n = static_cast<std::uint32_t>(v.size());
+    out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.append(v);
+}
+
+static bool getValue (const char*& p, const char* end, int& v) {
+    std::int32_t x;
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(x))) {
+        return false;
+    }
+    std::memcpy(&x, p, sizeof(x));
+    p += sizeof(x);
+    v = x;
+    return true;
+}
+
+static bool getValue (const char*& p, const char* end, double& v) {
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(v))) {
+        return false;
+    }
+    std::memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return true;
+}
+
+static bool getValue (const char*& p, const char* end, std::string& v) {
+    std::uint32_t n;
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(n))) {
+        return false;
+    }
+    std::memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    if (static_cast<std::size_t>(end - p) < n) {
+        return false;
+    }
+    v.assign(p, n);
+    p += n;
+    return true;
+}
+
+static std::int64_t mtimeNs (const struct stat& st) {
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec)*1000000000 + st.st_mtim.tv_nsec;
+}
+
+//fills the magic, the schema and the TOML fields of key from the file at PATH
+static bool sourceKey (const std::string& PATH, ConfigCacheHeader& key) {
+    int fd = open(PATH.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    std::string content;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        content.resize(static_cast<std::size_t>(st.st_size));
+        std::size_t got = 0;
+        while (got < content.size()) {
+            ssize_t r = read(fd, &content[got], content.size() - got);
+            if (r <= 0) {
+                if (r < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            got += static_cast<std::size_t>(r);
+        }
+        ok = (got == content.size());
+    }
+    close(fd);
+    if (!ok) {
+        return false;
+    }
+    std::memcpy(key.magic, CONFIG_CACHE_MAGIC, 8);
+    key.schema = schemaHash();
+    key.toml_size = content.size();
+    key.toml_mtime = mtimeNs(st);
+    key.toml_hash = imageHash(content.data(), content.size());
+    return true;
+}
+
+static bool profileKey (const std::string& profile, ConfigCacheHeader& key) {
+    struct stat st;
+    if (stat(profile.c_str(), &st) != 0) {
+        return false;
+    }
+    key.profile_size = static_cast<std::uint64_t>(st.st_size);
+    key.profile_mtime = mtimeNs(st);
+    return true;
+}
+
+static bool decodeImage (HWconfig& hw, const char* p, const char* end, const ConfigCacheHeader& key) {
+    bool ok = true;
+    hwSchema.visit([&] (const auto& f) {
+        ok = ok && getValue(p, end, hw.*f.member);
+    });
+    if (!ok || p == end) {
+        return false;
+    }
+    const bool has_profile = (*p++ == 1);
+    hw.profile = nullptr;
+    if (has_profile != !hw.carbon_profile.empty()) {
+        return false;
+    }
+    if (has_profile) {
+        ConfigCacheHeader now = key;
+        if (!profileKey(hw.carbon_profile, now) || now.profile_size != key.profile_size || now.profile_mtime != key.profile_mtime) {
+            return false;
+        }
+        auto profile = std::make_shared<CarbonProfile>();
+        if (!profile->deserialize(p, end) || profile->empty()) {
+            return false;
+        }
+        hw.profile = profile;
+    }
+    return p == end;
+}
+
+//loads hw from the image at CACHE if it was written for the sources described by key
+static bool readConfigCache (HWconfig& hw, const std::string& CACHE, const ConfigCacheHeader& key) {
+    int fd = open(CACHE.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    //read, not mapped: an image truncated by another process meanwhile is only a mismatch
+    struct stat st;
+    std::string image;
+    std::size_t length = 0;
+    if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(ConfigCacheHeader)) {
+        image.resize(static_cast<std::size_t>(st.st_size));
+        while (length < image.size()) {
+            ssize_t r = pread(fd, &image[length], image.size() - length, static_cast<off_t>(length));
+            if (r <= 0) {
+                if (r < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            length += static_cast<std::size_t>(r);
+        }
+    }
+    close(fd);
+    if (length < sizeof(ConfigCacheHeader)) {
+        return false;
+    }
+
+    const char* data = image.data();
+    ConfigCacheHeader h;
+    std::memcpy(&h, data, sizeof(h));
+    const char* payload = data + sizeof(h);
+    HWconfig decoded;
+    bool ok = std::memcmp(h.magic, key.magic, 8) == 0 && h.schema == key.schema &&
+              h.toml_size == key.toml_size && h.toml_mtime == key.toml_mtime && h.toml_hash == key.toml_hash &&
+              h.payload_size == length - sizeof(h) && h.payload_hash == imageHash(payload, h.payload_size) &&
+              decodeImage(decoded, payload, payload + h.payload_size, h);
+    if (ok) {
+        decoded.dram_power_per_gb = dramPowerPerGB(decoded.ram_family, decoded.ram_freq);
+        hw = std::move(decoded);
+    }
+    return ok;
+}
+
+//writes the image of hw, keyed by key, to a temporary file renamed over CACHE
+static bool writeConfigCache (const HWconfig& hw, const std::string& CACHE, ConfigCacheHeader key) {
+    std::string why;
+    if (!validConfig(hw, why) || hw.carbon_profile.empty() != (hw.profile == nullptr)) {
+        return false;
+    }
+    std::string image(sizeof(key), '\0');
+    hwSchema.visit([&] (const auto& f) {
+        putValue(image, hw.*f.member);
+    });
+    image.push_back(hw.profile ? 1 : 0);
+    if (hw.profile) {
+        hw.profile->serialize(image);
+    } else {
+        key.profile_size = 0;
+        key.profile_mtime = 0;
+    }
+    key.payload_size = image.size() - sizeof(key);
+    key.payload_hash = imageHash(image.data() + sizeof(key), key.payload_size);
+    std::memcpy(&image[0], &key, sizeof(key));
+
+    std::string tmp_path = CACHE + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const char* p = image.data();
+    std::size_t left = image.size();
+    while (left != 0) {
+        ssize_t w = write(fd, p, left);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += w;
+        left -= static_cast<std::size_t>(w);
+    }
+    bool ok = (close(fd) == 0) && left == 0;
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tmp_path, CACHE, ec);
+    }
+    if (!ok || ec) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
 /*!
  *  @brief
  *  This function parses the configuration file located at PATH, pulls the required
@@ -17,34 +342,119 @@
  * - A valid PATH has been set.
  * 
  * After the execution, both conditions will still be TRUE.
+ * If the file cannot be opened or read, a toml::file_io_error (a std::runtime_error) is thrown:
+ * it may have been renamed or replaced since PATH was checked, as editors save files.
+ * If decodeConfig() finds any error, a std::runtime_error listing all of them is thrown.
+ *
+ * With cache set, hw is loaded from the binary image at PATH + CONFIG_CACHE_SUFFIX when it was
+ * written for the current content of the file (see loadConfigCache()), skipping the parser.
+ * Otherwise the file is parsed and, if the result passes validConfig(), the image is rewritten
+ * for the next start. An image that cannot be written (e.g. in a read-only folder) is skipped.
  */
-void pullConfig (HWconfig& hw, std::string PATH) {
-    assert(std::filesystem::exists(std::filesystem::path{PATH}));
-    
-    toml::value config = toml::parse(PATH);
-    
-    const auto& exp_name = toml::find(config, "owner");
-    hw.exp_name = toml::find<std::string>(exp_name, "title");
-    
-    const auto& infra = toml::find(config, "infrastructure");
-    
-    hw.root_folder = toml::find<std::string>(infra, "root_folder");
-    hw.cpu_stat_file = toml::find<std::string>(infra, "cpu_stat_file");
-    hw.mem_stat_file = toml::find<std::string>(infra, "mem_stat_file");
-    
-    hw.arch = toml::find<std::string>(infra, "cpu_family");
-    hw.cpu_tdp = toml::find<int>(infra, "cpu_tdp");
-    hw.n_cpu = toml::find<int>(infra, "n_cpu");
-    hw.clock_ticks = toml::find<int>(infra, "clock_ticks");
+void pullConfig (HWconfig& hw, std::string PATH, bool cache) {
+    //keyed before parsing: an image of a file edited meanwhile does not match the edited file
+    ConfigCacheHeader key{};
+    bool keyed = cache && sourceKey(PATH, key);
+    if (keyed && readConfigCache(hw, PATH + CONFIG_CACHE_SUFFIX, key)) {
+        return;
+    }
+
+    toml::arena_scope arena;
+    const ConfigValue config = toml::parse<toml::compact_regions, toml::arena_map, toml::arena_vector>(PATH, toml::pread_file);
+
+    std::vector<std::string> errors = decodeConfig(hw, config);
+    if (!errors.empty()) {
+        std::string what = PATH + ":";
+        for (const auto& e : errors) {
+            what += " " + e + ";";
+        }
+        what.pop_back();
+        throw std::runtime_error(what);
+    }
+
+    hw.profile = nullptr;
+    if (!hw.carbon_profile.empty()) {
+        keyed = keyed && profileKey(hw.carbon_profile, key);
+        auto profile = std::make_shared<CarbonProfile>();
+        if (!profile->load(hw.carbon_profile) || profile->empty()) {
+            throw std::runtime_error("cannot load carbon profile " + hw.carbon_profile);
+        }
+        hw.profile = profile;
+    }
+
+    if (keyed) {
+        writeConfigCache(hw, PATH + CONFIG_CACHE_SUFFIX, key);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function fills an HWconfig from a parsed configuration file, in a single pass.
+ *
+ *  @param[out] hw:     An HWconfig object, every field but profile is set
+ *  @param[in]  config: The parsed configuration file
+ *
+ *  @return every missing key, value of the wrong type and value out of range, empty if none
+ */
+std::vector<std::string> decodeConfig (HWconfig& hw, const ConfigValue& config) {
+    std::vector<std::string> errors = hwSchema.decode(config, hw);
+    hw.dram_power_per_gb = dramPowerPerGB(hw.ram_family, hw.ram_freq);
+    return errors;
+}
+
+/*!
+ *  @brief
+ *  This function loads an HWconfig, carbon profile included, from the binary cache of the
+ *  configuration file at PATH, written by pullConfig() or saveConfigCache().
+ *
+ *  @param[out] hw:   An HWconfig object, untouched if false is returned
+ *  @param[in]  PATH: The path of the configuration file (not of the cache)
+ *
+ *  @return true if the cache exists and matches the current content of the configuration file
+ *  and of the carbon profile, and the schema of this version of KIG
+ *
+ *  @details
+ *  The cache is read in one pread() and copied field by field, without going through the parser.
+ */
+bool loadConfigCache (HWconfig& hw, const std::string& PATH) {
+    ConfigCacheHeader key{};
+    return sourceKey(PATH, key) && readConfigCache(hw, PATH + CONFIG_CACHE_SUFFIX, key);
+}
 
-    const auto& energy = toml::find(config, "energy");
-    hw.carbon_intensity = toml::find<double>(energy, "carbon_intensity");     
-    hw.pue = toml::find<double>(energy, "power_usage_efficiency");
+/*!
+ *  @brief
+ *  This function writes the binary cache of the configuration file at PATH, next to it.
+ *
+ *  @param[in] hw:   An HWconfig object, as pulled from the current content of PATH
+ *  @param[in] PATH: The path of the configuration file (not of the cache)
+ *
+ *  @return true if the cache has been written: hw passes validConfig() and the folder is writable
+ */
+bool saveConfigCache (const HWconfig& hw, const std::string& PATH) {
+    ConfigCacheHeader key{};
+    return sourceKey(PATH, key) && (hw.carbon_profile.empty() || profileKey(hw.carbon_profile, key)) &&
+           writeConfigCache(hw, PATH + CONFIG_CACHE_SUFFIX, key);
+}
 
-    if (toml::find<std::string>(infra, "ram_family")=="COMMON" && 
-        toml::find<int>(infra, "ram_size")==1) {
-            hw.ram_power_usage = 0.375;   // per-GB
+/*!
+ *  @brief
+ *  This function checks that the values of an HWconfig make sense before they are used.
+ *
+ *  @param[in]  hw:  An HWconfig object, typically filled by pullConfig()
+ *  @param[out] why: The reason of the rejection, untouched if hw is valid
+ *
+ *  @return true if hw can be used for monitoring
+ */
+bool validConfig (const HWconfig& hw, std::string& why) {
+    std::string rejected = hwSchema.check(hw);
+    if (rejected.empty() && hw.cpu_idle_power > hw.cpu_tdp) {
+        rejected = "cpu_idle_power must be between 0 and cpu_tdp";
+    }
+    if (rejected.empty()) {
+        return true;
     }
+    why = rejected;
+    return false;
 }
 
 /*!
@@ -81,266 +491,2662 @@ void fillBuffer (std::vector<std::string>& v, std::string PATH) {
 
 /*!
  *  @brief
- *  This function fetches how much RAM is allocated by the process and returns
- *  the value in GB.
- *  
- *  @param [in] PATH_MEM: The path at which the file containing info about allocated
- *                   ram is stored. Typically: "/proc/<pid>/status"
+ *  This function parses the content of a /proc/<pid>/stat file held in a raw buffer and
+ *  stores utime, stime, starttime, rss and num_threads inside a CPUsage object.
  *
- *  @return vmsize: The size (in GB) of allocated RAM
- *  
- *  @details
- *  the allocated RAM is considered to be the significant parameter for memory energy consumption in [1].
- *  At the time of execution of the function:
- * 		- PATH_MEM should be TRUE.
+ *  @param[in] c:   A CPUsage object.
+ *  @param[in] buf: The raw content of the stat file (not necessarily NUL-terminated)
+ *  @param[in] n:   The number of valid bytes in buf
  *
- * 	At the end of execution of the function:
- * 		- if the monitored process has finished, PATH_MEM will turn FALSE as the PID will get retired.
- *		- otherwise, PATH_MEM will still be TRUE
- * 
- * [1] Lannelongue, L. et al. "Green Algorithms: Quantifying the Carbon Footprint of Computation", Advanced Science, 2021.*
+ *  @return true if every required field was found, false otherwise.
+ *
+ *  @details
+ *  No memory is allocated. The comm field (2) is enclosed in parentheses and may contain
+ *  spaces or parentheses itself, so the scan restarts after the LAST ')' of the line, where
+ *  field 3 (state) begins. Numbering of the fields follows man 5 proc.
+ *  When false is returned, c is left partially updated and should not be used.
  */
+bool parseStat (CPUsage& c, const char* buf, std::size_t n) {
+    const char* end = buf + n;
+    const char* p = end;
+    while (p != buf && *(p-1) != ')') {
+        --p;
+    }
+    if (p == buf) {
+        return false;
+    }
 
-double fetchMem (std::string PATH_MEM) {
-    assert(std::filesystem::exists(std::filesystem::path{PATH_MEM}));
+    int field = 3;
+    while (p != end && field <= 24) {
+        while (p != end && *p == ' ') {
+            ++p;
+        }
+        if (p == end || *p == '\n') {
+            break;
+        }
 
-    std::ifstream memstat(PATH_MEM);
-    std::string mem;
-    for (int i=0; i<17; i++) {
-        memstat.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); 
-    }
-    std::getline(memstat, mem);
-    //std::cout << "allocated memory" << mem << '\n';
-    
-    std::stringstream s (mem);
-    std::string temp;
-    double vmsize;
-    while (!s.eof()) {
-        s >> temp;
-        if (std::stringstream(temp) >> vmsize) {
-                vmsize = vmsize/1000000;
-                break;
+        bool negative = (*p == '-');
+        if (negative) {
+            ++p;
+        }
+        unsigned long long value = 0;
+        while (p != end && *p >= '0' && *p <= '9') {
+            value = value*10 + static_cast<unsigned long long>(*p - '0');
+            ++p;
         }
+        while (p != end && *p != ' ' && *p != '\n') {              //state is a letter, skip it
+            ++p;
+        }
+
+        switch (field) {
+            case 14: c.utime = value; break;
+            case 15: c.stime = value; break;
+            case 20: c.num_threads = negative ? -static_cast<long>(value) : static_cast<long>(value); break;
+            case 22: c.starttime = value; break;
+            case 24: c.rss = negative ? -static_cast<long>(value) : static_cast<long>(value); break;
+            default: break;
+        }
+        ++field;
     }
-    return vmsize;
+    return field > 24;
 }
 
 /*!
  *  @brief
- *  This function extracts data from CPUsage buffer and uses it to initialize
- *  each member of a CPUsage object.
+ *  This function reads the file located at PATH, typically "/proc/<pid>/stat", with a single
+ *  read() into a fixed stack buffer and parses it through parseStat().
  *
- *  @param[in] c: A CPUsage object.
- *  @param[in] v: The data buffer used by fillBuffer() function
- *	@details
- *	At the end of the execution of this function:
- *  - c still exists (with updated fields).
- *  - v still exists, but it will be flushed.
- *  - T still exists,
+ *  @param[in] c:    A CPUsage object.
+ *  @param[in] PATH: The location of the file, typically "/proc/<pid>/stat"
+ *
+ *  @return true if c was updated, false if the file could not be read (e.g. the process has
+ *  been retired) or was malformed.
+ *
+ *  @details
+ *  It replaces the fillBuffer() + update() + flushBuffer() sequence without any heap allocation.
+ *  Unlike update(), up_time is NOT refreshed: the caller samples upTime() once per tick.
  */
+bool readStat (CPUsage& c, const std::string& PATH) {
+    int fd = open(PATH.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[STAT_BUFFER_SIZE];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    return parseStat(c, buf, static_cast<std::size_t>(n));
+}
 
-void update (CPUsage& c, std::vector<std::string>& v, struct sysinfo T) {
-    assert(v.size() != 0);
+/*!
+ *  @brief
+ *  This function opens /proc/<pid>/stat and /proc/<pid>/status for later sampling.
+ *
+ *  @param[in] hw:  An HWconfig object, providing root_folder, cpu_stat_file and mem_stat_file
+ *  @param[in] pid: The PID of the monitored process
+ *
+ *  @details
+ *  If the process does not exist the handle is created dead: alive() is false and sample()
+ *  returns false, so no separate existence check is needed.
+ */
+ProcHandle::ProcHandle (const HWconfig& hw, pid_t pid) : proc_id(pid), stat_fd(-1), status_fd(-1) {
+    std::string folder = hw.root_folder + std::to_string(pid);
+    stat_fd = open((folder + hw.cpu_stat_file).c_str(), O_RDONLY | O_CLOEXEC);
+    status_fd = open((folder + hw.mem_stat_file).c_str(), O_RDONLY | O_CLOEXEC);
+    if (stat_fd < 0 || status_fd < 0) {
+        release();
+    }
+}
 
-    sysinfo(&T);
-    c.utime = std::stod(v[13]);//c.proc_buffer[13]);
-    c.stime = std::stod(v[14]);
-    c.starttime = std::stod(v[21]);
-    c.up_time = T.uptime;
-    //std::cout << "saving utime: " << c.proc_buffer[13] << '\n';
+ProcHandle::ProcHandle (ProcHandle&& other) noexcept
+    : proc_id(other.proc_id), stat_fd(other.stat_fd), status_fd(other.status_fd) {
+    other.stat_fd = -1;
+    other.status_fd = -1;
+}
 
+ProcHandle& ProcHandle::operator= (ProcHandle&& other) noexcept {
+    if (this != &other) {
+        release();
+        proc_id = other.proc_id;
+        stat_fd = other.stat_fd;
+        status_fd = other.status_fd;
+        other.stat_fd = -1;
+        other.status_fd = -1;
+    }
+    return *this;
 }
 
-void flushBuffer (std::vector<std::string>& v) {
-    
-    v.clear();
-    //let's keep it this way for the moment, i think here a lambda can easily
-    //substitute everything with no problem at all.
+ProcHandle::~ProcHandle () {
+    release();
+}
+
+void ProcHandle::release () {
+    if (stat_fd >= 0) {
+        close(stat_fd);
+    }
+    if (status_fd >= 0) {
+        close(status_fd);
+    }
+    stat_fd = -1;
+    status_fd = -1;
 }
 
 /*!
  *  @brief
- *  This function converts CPUsage information from jiffies (clock ticks) to seconds and
- *  evaluates the elapsed computing time.
- * 
- *  Starting from the data saved in a CPUsage object, this function converts
- *  jiffies (clock ticks time-unit) to seconds using the internal CLK_TCK parameter. The elapsed computing time 
- *  is then saved into the CPUsage object, and the CPU usage factor is returned.
- * 
+ *  This function re-reads the stat and status files of the process and updates a CPUsage object.
+ *
  *  @param[in] c: A CPUsage object.
- *  @param[in] hw: An HWconfig object.
  *
- *  @return cpu_usage: A vector containing the sampled cpu usage over computing
- *  time
- * 
- * @details
- * Before execution:
- * 	- c should be TRUE.
- * 	- hw should be TRUE.
- * After execution:
- 	- c still TRUE.
- 	- hw still TRUE.
- 	- cpu_usage should be bound (0,1]. 0 should correspond to a purely sleeping process and therefore is considered not included in the range.
-*/
+ *  @return true if c was updated, false if the process has been retired.
+ *
+ *  @details
+ *  utime, stime, starttime, rss and num_threads are filled as in parseStat(), vm_size with the
+ *  VmSize entry (kB) of the status file. As in readStat(), up_time is left to the caller.
+ *  After the first failed read the handle releases its descriptors and alive() turns false.
+ */
+bool ProcHandle::sample (CPUsage& c) {
+    MemStatus m;
+    return sample(c, m);
+}
 
-double CPUusage (CPUsage& c, HWconfig& hw) {
-    //this function too can be translated to a lambda since it only does a
-    //single action. Still, first we build the toy model, then we optimize the
-    //structures.
-    
-    c.starttime = c.starttime/hw.clock_ticks;                      //converting to seconds
-    double utime_sec = c.utime / hw.clock_ticks;
-    double stime_sec = c.stime / hw.clock_ticks;
-    //std::cout << "UTIME_JIFF: " << c.utime << '\n';
-    //std::cout << "UTIME: " << utime_sec << '\n';
-    //std::cout << "STIME: " << stime_sec << '\n';
-    double cpu_occupation = (utime_sec/hw.n_cpu) + stime_sec;    		   //converting to seconds
-    double elapsed_time = (c.up_time - c.starttime);               //measured in seconds
-    c.elapsed_time = elapsed_time;
-    //std::cout << "CLK_TCK: " << hw.clock_ticks;
-    std::cout << "OCCUPIED: " << cpu_occupation << '\n';
-    std::cout << "ELAPSED: " << elapsed_time << '\n';
-    double cpu_usage = cpu_occupation/elapsed_time;             //this is actually a percentage
-    //std::cout << "CPU usage: " << cpu_usage << '\n';
-    return cpu_usage;
+/*!
+ *  @brief
+ *  As sample(CPUsage&), additionally returning every entry of the status file kept in MemStatus.
+ *
+ *  @param[in] c: A CPUsage object.
+ *  @param[in] m: A MemStatus object.
+ *
+ *  @return true if c and m were updated, false if the process has been retired.
+ */
+bool ProcHandle::sample (CPUsage& c, MemStatus& m) {
+    if (!alive()) {
+        return false;
+    }
+
+    char buf[STATUS_BUFFER_SIZE];
+    ssize_t n = pread(stat_fd, buf, STAT_BUFFER_SIZE, 0);
+    if (n <= 0 || !parseStat(c, buf, static_cast<std::size_t>(n))) {
+        release();
+        return false;
+    }
 
+    n = pread(status_fd, buf, sizeof(buf), 0);
+    if (n <= 0 || !parseStatus(m, buf, static_cast<std::size_t>(n))) {
+        release();
+        return false;
+    }
+    c.vm_size = m.vm_size;
+    return true;
 }
 
 /*!
  *  @brief
- *  This function uses CPU usage, RAM usage and infrastructure parameters to provide an
- *  estimation of the Carbon footprint of a running process on a Linux environment.
- *  
- *  This function extracts the carbon footprint of the process as defined in [1]
- *  The value returned is measured in gCO2e.
- *  
- *  @param[in] cpu_data: A vector containing the CPU usage factor over the execution
- *  time.
- *  @param[in] mem_data: A vector containing the size of RAM allocated by process
- *  over execution time
- *  @param[in] hw: An HWconfig object.
- *  @param[in] et: The elapsed computing time
+ *  This function sets up the monitoring of the process tree rooted at pid.
+ *
+ *  @param[in] hw:  An HWconfig object, providing root_folder, cpu_stat_file and mem_stat_file.
+ *                  It is referenced, so it must outlive the ProcessTree.
+ *  @param[in] pid: The PID of the root process
  *
- *  @return X: The value in gCO2e of the carbon footprint of process.
- *	
  *  @details
- *  Before execution:
- *		- cpu_data is TRUE and cpu_data.size() == 0
- * 		- mem_data is TRUE and mem_data.size() == 0
- *		- hw is TRUE
- *		- et is TRUE and != 0
+ *  Descendants are discovered by the first call to sample().
+ */
+ProcessTree::ProcessTree (const HWconfig& hw, pid_t pid) : hw(hw), root(pid), retired_utime(0), retired_stime(0) {
+    addNode(root);
+}
+
+ProcessTree::~ProcessTree () {
+    while (!nodes.empty()) {
+        removeNode(nodes.begin()->first);
+    }
+}
+
+void ProcessTree::addNode (pid_t pid) {
+    nodes.emplace(pid, Node{ProcHandle(hw, pid), {}, -1, {}, 0, 0});
+    worklist.push_back(pid);
+}
+
+void ProcessTree::removeNode (pid_t pid) {
+    auto it = nodes.find(pid);
+    for (int fd : it->second.children_fds) {
+        close(fd);
+    }
+    retired_utime += it->second.utime;
+    retired_stime += it->second.stime;
+    nodes.erase(it);
+}
+
+/*!
+ *  @brief
+ *  This function (re)opens the children file of every task of a process.
+ */
+void ProcessTree::scanTasks (pid_t pid, Node& node) {
+    for (int fd : node.children_fds) {
+        close(fd);
+    }
+    node.children_fds.clear();
+
+    std::string task_folder = hw.root_folder + std::to_string(pid) + "/task/";
+    DIR* dir = opendir(task_folder.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        std::string path = task_folder + entry->d_name + "/children";
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            node.children_fds.push_back(fd);
+        }
+    }
+    closedir(dir);
+}
+
+/*!
+ *  @brief
+ *  This function re-reads the children files of a process and adds unknown children to the tree.
+ *
+ *  @details
+ *  If one of the tasks has gone away its read fails, and the task directory is listed again
+ *  at the next sample. Children that have exited are not removed here: their own sample fails.
+ */
+void ProcessTree::scanChildren (Node& node) {
+    scratch.clear();
+    char buf[STAT_BUFFER_SIZE];
+    for (int fd : node.children_fds) {
+        ssize_t n;
+        off_t offset = 0;
+        while ((n = pread(fd, buf, sizeof(buf), offset)) > 0) {
+            scratch.append(buf, static_cast<std::size_t>(n));
+            offset += n;
+        }
+        if (n < 0) {
+            node.n_tasks = -1;
+        }
+    }
+    if (scratch == node.children) {
+        return;
+    }
+    node.children.swap(scratch);
+
+    pid_t child = 0;
+    for (char ch : node.children) {
+        if (ch >= '0' && ch <= '9') {
+            child = child*10 + (ch - '0');
+        }
+        else {
+            if (child != 0 && nodes.count(child) == 0) {
+                addNode(child);
+            }
+            child = 0;
+        }
+    }
+    if (child != 0 && nodes.count(child) == 0) {
+        addNode(child);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function samples every process of the tree, discovering new descendants on the way,
+ *  and returns the aggregated figures.
+ *
+ *  @param[in] c: A CPUsage object receiving the totals of the tree.
+ *  @param[in] m: A MemStatus object receiving the totals of the tree.
+ *
+ *  @return true while at least one process of the tree is alive.
+ *
+ *  @details
+ *  utime and stime include the last sampled ticks of retired descendants, starttime is the one
+ *  of the root, rss, num_threads and every MemStatus field are summed over the live processes.
+ *  As in ProcHandle::sample(), up_time is left to the caller.
+ */
+bool ProcessTree::sample (CPUsage& c, MemStatus& m) {
+    c.utime = 0;
+    c.stime = 0;
+    c.rss = 0;
+    c.num_threads = 0;
+    c.vm_size = 0;
+    m = MemStatus{};
+
+    worklist.clear();
+    for (const auto& n : nodes) {
+        worklist.push_back(n.first);
+    }
+
+    CPUsage proc;
+    MemStatus proc_mem;
+    for (std::size_t i = 0; i < worklist.size(); i++) {         //addNode() appends to worklist
+        pid_t pid = worklist[i];
+        Node& node = nodes.find(pid)->second;
+        if (!node.handle.sample(proc, proc_mem)) {
+            removeNode(pid);
+            continue;
+        }
+        node.utime = proc.utime;
+        node.stime = proc.stime;
+
+        if (proc.num_threads != node.n_tasks) {
+            scanTasks(pid, node);
+            node.n_tasks = proc.num_threads;
+        }
+        scanChildren(node);
+
+        if (pid == root) {
+            c.starttime = proc.starttime;
+        }
+        c.utime += proc.utime;
+        c.stime += proc.stime;
+        c.rss += proc.rss;
+        c.num_threads += proc.num_threads;
+        c.vm_size += proc.vm_size;
+        m.vm_size += proc_mem.vm_size;
+        m.vm_rss += proc_mem.vm_rss;
+        m.vm_hwm += proc_mem.vm_hwm;
+        m.rss_anon += proc_mem.rss_anon;
+        m.rss_file += proc_mem.rss_file;
+        m.vm_swap += proc_mem.vm_swap;
+        m.threads += proc_mem.threads;
+    }
+    c.utime += retired_utime;
+    c.stime += retired_stime;
+    return !nodes.empty();
+}
+
+/*!
+ *  @brief
+ *  This function opens a ProcHandle for every PID of the set and allocates one slot per PID.
+ *
+ *  @param[in] hw:   An HWconfig object, providing root_folder, cpu_stat_file and mem_stat_file
+ *  @param[in] pids: The monitored PIDs. Slot i refers to pids[i].
+ */
+Sampler::Sampler (const HWconfig& hw, const std::vector<pid_t>& pids)
+    : utime_(pids.size(), 0), stime_(pids.size(), 0), starttime_(pids.size(), 0),
+      rss_(pids.size(), 0), vm_size_(pids.size(), 0), alive_(pids.size(), 0),
+      prev_utime(pids.size(), 0), prev_stime(pids.size(), 0), now(0), uptime(0), prev_uptime(0) {
+    handles.reserve(pids.size());
+    for (pid_t pid : pids) {
+        handles.emplace_back(hw, pid);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function samples every PID of the set once.
+ *
+ *  @return The number of PIDs still alive.
+ *
+ *  @details
+ *  Retired PIDs are skipped without any syscall.
+ */
+std::size_t Sampler::tick () {
+    prev_uptime = uptime;
+    prev_utime = utime_;
+    prev_stime = stime_;
+
+    uptime = upTime();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec + ts.tv_nsec*1e-9;
+
+    CPUsage c;
+    MemStatus m;
+    std::size_t live = 0;
+    for (std::size_t i = 0; i < handles.size(); i++) {
+        if (!handles[i].sample(c, m)) {
+            rss_[i] = 0;
+            vm_size_[i] = 0;
+            alive_[i] = 0;
+            continue;
+        }
+        utime_[i] = c.utime;
+        stime_[i] = c.stime;
+        starttime_[i] = c.starttime;
+        rss_[i] = c.rss;
+        vm_size_[i] = m.vm_size;
+        alive_[i] = 1;
+        live++;
+    }
+    return live;
+}
+
+/*!
+ *  @brief
+ *  This function returns utime + stime, in clock ticks, summed over every slot.
+ */
+unsigned long long Sampler::totalTicks () const {
+    unsigned long long total = 0;
+    for (std::size_t i = 0; i < utime_.size(); i++) {
+        total += utime_[i] + stime_[i];
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the allocated RAM (VmSize, kB) summed over the live slots.
+ */
+double Sampler::totalVmSize () const {
+    long total = 0;
+    for (std::size_t i = 0; i < vm_size_.size(); i++) {
+        total += vm_size_[i];
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the CPU usage factor of the whole PID set, i.e. the sum over the
+ *  live slots of the per-process factor computed as in CPUusage().
+ *
+ *  @param[in] hw: An HWconfig object.
+ */
+double Sampler::totalUsage (const HWconfig& hw) const {
+    const double clk = hw.clock_ticks;
+    const double n_cpu = hw.n_cpu;
+    double total = 0;
+    for (std::size_t i = 0; i < utime_.size(); i++) {
+        double occupation = (utime_[i]/clk)/n_cpu + stime_[i]/clk;
+        double elapsed = uptime - starttime_[i]/clk;
+        total += alive_[i] && elapsed > 0 ? occupation/elapsed : 0.;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the CPU usage factor of the whole PID set over the last interval
+ *  between two ticks, i.e. the sum over the slots of the per-process factor computed as in
+ *  CPUusageDelta().
+ *
+ *  @param[in] hw: An HWconfig object.
+ *
+ *  @details
+ *  Before the second tick there is no interval yet, and totalUsage() is returned instead.
+ *  Slots retired during the interval contribute the ticks consumed until their last sample.
+ */
+double Sampler::totalIntervalUsage (const HWconfig& hw) const {
+    double dt = interval();
+    if (dt <= 0) {
+        return totalUsage(hw);
+    }
+    const double clk = hw.clock_ticks;
+    const double n_cpu = hw.n_cpu;
+    double total = 0;
+    for (std::size_t i = 0; i < utime_.size(); i++) {
+        total += ((utime_[i] - prev_utime[i])/clk)/n_cpu + (stime_[i] - prev_stime[i])/clk;
+    }
+    return total/dt;
+}
+
+static long long monotonicNow () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/*!
+ *  @brief
+ *  This function sets up a scheduler whose first deadline is one period from now.
+ *
+ *  @param[in] period_ms: The sampling period in milliseconds (fractions allowed), > 0
+ */
+Scheduler::Scheduler (double period_ms)
+    : period(static_cast<long long>(period_ms*1e6)), next(monotonicNow()), n_ticks(0), n_missed(0) {
+    assert(period > 0);
+}
+
+/*!
+ *  @brief
+ *  This function sleeps until the next deadline.
+ *
+ *  @details
+ *  If the next deadline has already passed when wait() is called, every overrun deadline is
+ *  counted as missed and the scheduler sleeps until the first deadline still in the future,
+ *  keeping the original phase.
+ */
+void Scheduler::wait () {
+    next += period;
+    long long now = monotonicNow();
+    if (now >= next) {
+        long long overrun = (now - next)/period + 1;
+        n_missed += static_cast<std::size_t>(overrun);
+        next += overrun*period;
+    }
+
+    struct timespec deadline;
+    deadline.tv_sec = next/1000000000LL;
+    deadline.tv_nsec = next%1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+
+    lateness.push((monotonicNow() - next)*1e-9);
+    n_ticks++;
+}
+
+/*!
+ *  @brief
+ *  This function changes the sampling period: the next deadline is set one new period after
+ *  the last one, keeping the phase of the ticks already done.
+ *
+ *  @param[in] period_ms: The new sampling period in milliseconds, > 0
+ */
+void Scheduler::setPeriod (double period_ms) {
+    period = static_cast<long long>(period_ms*1e6);
+    assert(period > 0);
+}
+
+/*!
+ *  @brief
+ *  This function returns the CPU usage factor of a single slot over the last interval between
+ *  two ticks, computed as in CPUusageDelta().
+ *
+ *  @param[in] slot: The slot of the PID
+ *  @param[in] hw:   An HWconfig object.
+ *
+ *  @details
+ *  Before the second tick there is no interval yet, and 0 is returned.
+ */
+double Sampler::intervalUsage (std::size_t slot, const HWconfig& hw) const {
+    double dt = interval();
+    if (dt <= 0) {
+        return 0.;
+    }
+    const double clk = hw.clock_ticks;
+    return (((utime_[slot] - prev_utime[slot])/clk)/hw.n_cpu + (stime_[slot] - prev_stime[slot])/clk)/dt;
+}
+
+static std::vector<int> parseCpuList (const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream iss(list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+        if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0]))) {
+            continue;
+        }
+        std::size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = (dash == std::string::npos) ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/*!
+ *  @brief
+ *  This function lists the CPUs of every online NUMA node.
+ *
+ *  @param[in] root: The sysfs folder of the nodes, usually /sys/devices/system/node/
+ *
+ *  @return One list of CPUs per online node, in node order; empty if the kernel exposes no node.
+ */
+std::vector<std::vector<int>> numaCpus (const std::string& root) {
+    std::vector<std::vector<int>> nodes;
+    std::ifstream online(root + "online");
+    std::string list;
+    if (!std::getline(online, list)) {
+        return nodes;
+    }
+    for (int node : parseCpuList(list)) {
+        std::ifstream cpulist(root + "node" + std::to_string(node) + "/cpulist");
+        std::string cpus;
+        std::getline(cpulist, cpus);
+        nodes.push_back(parseCpuList(cpus));
+    }
+    return nodes;
+}
+
+/*!
+ *  @brief
+ *  This function partitions pids in shards and starts one worker thread per shard.
+ *
+ *  @param[in] hw:        An HWconfig object. It is referenced, so it must outlive the sampler.
+ *  @param[in] pids:      The PIDs to monitor
+ *  @param[in] n_threads: The number of workers, 0 for one per NUMA node
+ *
+ *  @details
+ *  There are never more workers than PIDs. Worker i is pinned to the CPUs of NUMA node i modulo
+ *  the number of nodes, so with the default each node samples its own share of the set.
+ */
+ShardedSampler::ShardedSampler (const HWconfig& hw, const std::vector<pid_t>& pids, std::size_t n_threads)
+    : hw(&hw), n_pids(pids.size()), generation(0), pending(0), stopping(false) {
+    auto nodes = numaCpus();
+    if (n_threads == 0) {
+        n_threads = nodes.empty() ? 1 : nodes.size();
+    }
+    n_threads = std::max<std::size_t>(1, std::min(n_threads, pids.size()));
+
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < n_threads; i++) {
+        std::size_t end = begin + (pids.size() - begin)/(n_threads - i);
+        std::vector<pid_t> part(std::begin(pids) + begin, std::begin(pids) + end);
+        parts.push_back(std::make_unique<Shard>(hw, part, begin));
+        if (nodes.size() > 1) {
+            parts.back()->cpus = nodes[i % nodes.size()];
+        }
+        begin = end;
+    }
+    for (std::size_t i = 0; i < parts.size(); i++) {
+        workers.emplace_back(&ShardedSampler::run, this, i);
+    }
+}
+
+ShardedSampler::~ShardedSampler () {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+void ShardedSampler::sampleShard (Shard& s) {
+    s.live = s.sampler.tick();
+    s.ticks = s.sampler.totalTicks();
+    s.vm_size = s.sampler.totalVmSize();
+    s.usage = s.sampler.totalUsage(*hw);
+    s.interval_usage = s.sampler.totalIntervalUsage(*hw);
+}
+
+void ShardedSampler::run (std::size_t i) {
+    Shard& s = *parts[i];
+    if (!s.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : s.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    std::size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        start_cv.wait(lock, [&]{ return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        sampleShard(s);
+        lock.lock();
+        if (--pending == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+/*!
+ *  @brief
+ *  This function samples every PID of the set once, each shard on its worker.
+ *
+ *  @return The number of PIDs still alive.
+ */
+std::size_t ShardedSampler::tick () {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        pending = parts.size();
+        generation++;
+        start_cv.notify_all();
+        done_cv.wait(lock, [this]{ return pending == 0; });
+    }
+    std::size_t live = 0;
+    for (const auto& s : parts) {
+        live += s->live;
+    }
+    return live;
+}
+
+/*!
+ *  @brief
+ *  This function returns utime + stime, in clock ticks, summed over every shard.
+ */
+unsigned long long ShardedSampler::totalTicks () const {
+    unsigned long long total = 0;
+    for (const auto& s : parts) {
+        total += s->ticks;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the allocated RAM (VmSize, kB) summed over every shard.
+ */
+double ShardedSampler::totalVmSize () const {
+    double total = 0;
+    for (const auto& s : parts) {
+        total += s->vm_size;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the lifetime CPU usage factor of the whole set, as Sampler::totalUsage().
+ */
+double ShardedSampler::totalUsage () const {
+    double total = 0;
+    for (const auto& s : parts) {
+        total += s->usage;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function returns the CPU usage factor of the whole set over the last interval, as
+ *  Sampler::totalIntervalUsage().
+ */
+double ShardedSampler::totalIntervalUsage () const {
+    double total = 0;
+    for (const auto& s : parts) {
+        total += s->interval_usage;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function fetches how much RAM is allocated by the process and returns
+ *  the value in GB.
+ *  
+ *  @param [in] PATH_MEM: The path at which the file containing info about allocated
+ *                   ram is stored. Typically: "/proc/<pid>/status"
+ *
+ *  @return vmsize: The size (in GB) of allocated RAM
+ *  
+ *  @details
+ *  the allocated RAM is considered to be the significant parameter for memory energy consumption in [1].
+ *  It is the VmSize entry, looked up by key through fetchStatus().
+ *  At the time of execution of the function:
+ * 		- PATH_MEM should be TRUE.
+ *
+ * 	At the end of execution of the function:
+ * 		- if the monitored process has finished, PATH_MEM will turn FALSE as the PID will get retired.
+ *		- otherwise, PATH_MEM will still be TRUE
+ * 
+ * [1] Lannelongue, L. et al. "Green Algorithms: Quantifying the Carbon Footprint of Computation", Advanced Science, 2021.*
+ */
+
+double fetchMem (std::string PATH_MEM) {
+    assert(std::filesystem::exists(std::filesystem::path{PATH_MEM}));
+
+    double vmsize = fetchStatus(PATH_MEM).vm_size;
+    return vmsize/1000000;
+}
+
+/*!
+ *  @brief
+ *  This function scans the content of a /proc/<pid>/status file held in a raw buffer and
+ *  stores VmSize, VmRSS, VmHWM, RssAnon, RssFile, VmSwap and Threads inside a MemStatus object.
+ *
+ *  @param[in] m:   A MemStatus object.
+ *  @param[in] buf: The raw content of the status file (not necessarily NUL-terminated)
+ *  @param[in] n:   The number of valid bytes in buf
+ *
+ *  @return true if the Threads entry, present in every status file, was found.
+ *
+ *  @details
+ *  Entries are matched by key in a single pass, so the result does not depend on the line
+ *  order of a given kernel. Missing entries (e.g. Vm* for kernel threads) are set to 0.
+ */
+bool parseStatus (MemStatus& m, const char* buf, std::size_t n) {
+    static const struct {
+        const char* key;
+        std::size_t len;
+        long MemStatus::* field;
+    } entries[] = {
+        {"VmSize:",  7, &MemStatus::vm_size},
+        {"VmRSS:",   6, &MemStatus::vm_rss},
+        {"VmHWM:",   6, &MemStatus::vm_hwm},
+        {"RssAnon:", 8, &MemStatus::rss_anon},
+        {"RssFile:", 8, &MemStatus::rss_file},
+        {"VmSwap:",  7, &MemStatus::vm_swap},
+        {"Threads:", 8, &MemStatus::threads},
+    };
+
+    m = MemStatus{};
+    bool threads_found = false;
+    const char* p = buf;
+    const char* end = buf + n;
+    while (p != end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        if (*p == 'V' || *p == 'R' || *p == 'T') {
+            for (const auto& e : entries) {
+                if (static_cast<std::size_t>(eol - p) > e.len && std::memcmp(p, e.key, e.len) == 0) {
+                    const char* q = p + e.len;
+                    while (q != eol && (*q == ' ' || *q == '\t')) {
+                        ++q;
+                    }
+                    long value = 0;
+                    while (q != eol && *q >= '0' && *q <= '9') {
+                        value = value*10 + (*q - '0');
+                        ++q;
+                    }
+                    m.*(e.field) = value;
+                    threads_found = threads_found || e.field == &MemStatus::threads;
+                    break;
+                }
+            }
+        }
+        p = (eol == end) ? end : eol + 1;
+    }
+    return threads_found;
+}
+
+/*!
+ *  @brief
+ *  This function reads the file located at PATH_MEM, typically "/proc/<pid>/status", with a
+ *  single read() and returns its memory related entries.
+ *
+ *  @param[in] PATH_MEM: The path of the status file.
+ *
+ *  @return m: A MemStatus object, values in kB.
+ *
+ *  @details
+ *  At the time of execution of the function PATH_MEM should be TRUE, as in fetchMem().
+ *  If the process is retired in between, every field of the returned MemStatus is 0.
+ */
+MemStatus fetchStatus (std::string PATH_MEM) {
+    assert(std::filesystem::exists(std::filesystem::path{PATH_MEM}));
+
+    MemStatus m{};
+    int fd = open(PATH_MEM.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return m;
+    }
+    char buf[STATUS_BUFFER_SIZE];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (n > 0) {
+        parseStatus(m, buf, static_cast<std::size_t>(n));
+    }
+    return m;
+}
+
+/*!
+ *  @brief
+ *  This function extracts data from CPUsage buffer and uses it to initialize
+ *  each member of a CPUsage object.
+ *
+ *  @param[in] c: A CPUsage object.
+ *  @param[in] v: The data buffer used by fillBuffer() function
+ *	@details
+ *	At the end of the execution of this function:
+ *  - c still exists (with updated fields).
+ *  - v still exists, but it will be flushed.
+ *  - T still exists,
+ */
+
+void update (CPUsage& c, std::vector<std::string>& v, struct sysinfo T) {
+    assert(v.size() != 0);
+
+    sysinfo(&T);
+    c.utime = std::stoull(v[13]);//c.proc_buffer[13]);
+    c.stime = std::stoull(v[14]);
+    c.starttime = std::stoull(v[21]);
+    c.up_time = T.uptime;
+    //std::cout << "saving utime: " << c.proc_buffer[13] << '\n';
+
+}
+
+void flushBuffer (std::vector<std::string>& v) {
+    
+    v.clear();
+    //let's keep it this way for the moment, i think here a lambda can easily
+    //substitute everything with no problem at all.
+}
+
+/*!
+ *  @brief
+ *  This function returns the time elapsed since the last boot, in seconds.
+ *
+ *  @details
+ *  It reads CLOCK_BOOTTIME, the clock starttime in /proc/<pid>/stat refers to, with
+ *  nanosecond resolution instead of the whole seconds of sysinfo().
+ */
+double upTime () {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*!
+ *  @brief
+ *  This function converts CPUsage information from jiffies (clock ticks) to seconds and
+ *  evaluates the elapsed computing time.
+ * 
+ *  Starting from the data saved in a CPUsage object, this function converts
+ *  jiffies (clock ticks time-unit) to seconds using the internal CLK_TCK parameter. The elapsed computing time 
+ *  is then saved into the CPUsage object, and the CPU usage factor is returned.
+ * 
+ *  @param[in] c: A CPUsage object.
+ *  @param[in] hw: An HWconfig object.
+ *
+ *  @return cpu_usage: A vector containing the sampled cpu usage over computing
+ *  time
+ * 
+ * @details
+ * Before execution:
+ * 	- c should be TRUE.
+ * 	- hw should be TRUE.
+ * After execution:
+ 	- c still TRUE.
+ 	- hw still TRUE.
+ 	- cpu_usage should be bound (0,1]. 0 should correspond to a purely sleeping process and therefore is considered not included in the range.
+ * The occupied and elapsed times are sent to the log at LogLevel::debug.
+*/
+
+double CPUusage (CPUsage& c, HWconfig& hw) {
+    //this function too can be translated to a lambda since it only does a
+    //single action. Still, first we build the toy model, then we optimize the
+    //structures.
+    
+    double starttime_sec = static_cast<double>(c.starttime) / hw.clock_ticks;     //converting to seconds
+    double utime_sec = static_cast<double>(c.utime) / hw.clock_ticks;
+    double stime_sec = static_cast<double>(c.stime) / hw.clock_ticks;
+    //std::cout << "UTIME_JIFF: " << c.utime << '\n';
+    //std::cout << "UTIME: " << utime_sec << '\n';
+    //std::cout << "STIME: " << stime_sec << '\n';
+    double cpu_occupation = (utime_sec/hw.n_cpu) + stime_sec;    		   //converting to seconds
+    double elapsed_time = (c.up_time - starttime_sec);             //measured in seconds
+    c.elapsed_time = elapsed_time;
+    //std::cout << "CLK_TCK: " << hw.clock_ticks;
+    if (logEnabled(LogLevel::debug)) {
+        logValue(LogLevel::debug, "OCCUPIED", cpu_occupation);
+        logValue(LogLevel::debug, "ELAPSED", elapsed_time);
+    }
+    double cpu_usage = cpu_occupation/elapsed_time;             //this is actually a percentage
+    //std::cout << "CPU usage: " << cpu_usage << '\n';
+    return cpu_usage;
+
+}
+
+/*!
+ *  @brief
+ *  This function evaluates the CPU usage factor of a process over the interval since its
+ *  previous call, together with the lifetime factor returned by CPUusage().
+ *
+ *  @param[in] c: A CPUsage object, sampled with up_time set.
+ *  @param[in] hw: An HWconfig object.
+ *
+ *  @return r: A CPUreading object holding the interval and the lifetime usage factors and the
+ *  length dt of the interval, in seconds.
+ *
+ *  @details
+ *  The occupation is computed as in CPUusage(), on the difference between the current and the
+ *  previous counters: interval = Δoccupation/Δup_time. On the first call the interval starts
+ *  when the process was started, so interval == lifetime. The counters are then saved inside c.
+ *  Summing interval*dt over the samples gives exactly the occupation accumulated since the start.
+ *  elapsed_time is updated as in CPUusage().
+ */
+CPUreading CPUusageDelta (CPUsage& c, const HWconfig& hw) {
+    double starttime_sec = static_cast<double>(c.starttime) / hw.clock_ticks;
+    double prev_time = (c.prev_up_time > 0) ? c.prev_up_time : starttime_sec;
+
+    double utime_sec = static_cast<double>(c.utime) / hw.clock_ticks;
+    double stime_sec = static_cast<double>(c.stime) / hw.clock_ticks;
+    double d_utime_sec = static_cast<double>(c.utime - c.prev_utime) / hw.clock_ticks;
+    double d_stime_sec = static_cast<double>(c.stime - c.prev_stime) / hw.clock_ticks;
+
+    CPUreading r;
+    c.elapsed_time = c.up_time - starttime_sec;
+    r.dt = c.up_time - prev_time;
+    r.lifetime = (c.elapsed_time > 0) ? ((utime_sec/hw.n_cpu) + stime_sec)/c.elapsed_time : 0.;
+    r.interval = (r.dt > 0) ? ((d_utime_sec/hw.n_cpu) + d_stime_sec)/r.dt : 0.;
+
+    c.prev_utime = c.utime;
+    c.prev_stime = c.stime;
+    c.prev_up_time = c.up_time;
+    return r;
+}
+
+/*!
+ *  @brief
+ *  This function uses CPU usage, RAM usage and infrastructure parameters to provide an
+ *  estimation of the Carbon footprint of a running process on a Linux environment.
+ *  
+ *  This function extracts the carbon footprint of the process as defined in [1]
+ *  The value returned is measured in gCO2e.
+ *  
+ *  @param[in] cpu_data: A vector containing the CPU usage factor over the execution
+ *  time.
+ *  @param[in] mem_data: A vector containing the size of RAM allocated by process
+ *  over execution time
+ *  @param[in] hw: An HWconfig object.
+ *  @param[in] et: The elapsed computing time
+ *
+ *  @return X: The value in gCO2e of the carbon footprint of process.
+ *	
+ *  @details
+ *  It is a thin wrapper over EnergyAccumulator, which computes the same averages without
+ *  keeping the whole history of samples and should be preferred for long runs.
+ *  The intermediate figures are sent to the log at LogLevel::info.
+ *
+ *  Before execution:
+ *		- cpu_data is TRUE and cpu_data.size() == 0
+ * 		- mem_data is TRUE and mem_data.size() == 0
+ *		- hw is TRUE
+ *		- et is TRUE and != 0
  
  * 	After execution:
  *		- The carbon footprint X is returned, it should be a non-zero value.
 */
 
-double carbonFootprint (std::vector<double>& cpu_data, std::vector<double>& mem_data, HWconfig& hw, double et) {
-    assert (cpu_data.size() != 0 && mem_data.size() != 0 && et != 0);
+double carbonFootprint (std::vector<double>& cpu_data, std::vector<double>& mem_data, HWconfig& hw, double et) {
+    assert (cpu_data.size() != 0 && mem_data.size() != 0 && et != 0);
+
+    EnergyAccumulator acc(hw);
+    for (std::size_t i = 0; i < cpu_data.size(); i++) {
+        acc.push(static_cast<double>(i), cpu_data[i], mem_data[i]);
+    }
+    
+    auto avg_CPU_usage = acc.cpu().mean;
+    auto avg_mem_alloc = acc.mem().mean;
+
+    double core_consumption = hw.n_cpu * hw.cpu_tdp * avg_CPU_usage;
+    double mem_consumption = avg_mem_alloc * hw.ram_power_usage;
+    
+    if (logEnabled(LogLevel::info)) {
+        logValue(LogLevel::info, "REQUESTED CORES", hw.n_cpu);
+        logValue(LogLevel::info, "TDP_PER_CORE", hw.cpu_tdp);
+        logValue(LogLevel::info, "AVG_CPU_USAGE", avg_CPU_usage);
+        logValue(LogLevel::info, "AVG_MEM_ALLOC (GB)", avg_mem_alloc);
+        logValue(LogLevel::info, "RAM W", hw.ram_power_usage);
+        logValue(LogLevel::info, "CORE W", core_consumption);
+        logValue(LogLevel::info, "MEM W", mem_consumption);
+        logValue(LogLevel::info, "ABSORBED W", core_consumption + mem_consumption);
+        logValue(LogLevel::info, "ELAPSED T", et);
+        logValue(LogLevel::info, "PUE", hw.pue);
+        logValue(LogLevel::info, "CARBON INTENSITY", hw.carbon_intensity);
+    }
+    
+    return hw.carbon_intensity * (et * (core_consumption + mem_consumption) * hw.pue * 0.001);
+    
+}
+
+void RunningStats::push (double x) {
+    n++;
+    double delta = x - mean;
+    mean += delta/n;
+    m2 += delta*(x - mean);
+    min = std::min(min, x);
+    max = std::max(max, x);
+}
+
+static double realtimeNow () {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+EnergyAccumulator::EnergyAccumulator (const HWconfig& hw)
+    : hw(&hw), tdp(hw), source(nullptr), energy(0), grams(0), epoch_offset(realtimeNow() - upTime()), cursor(0),
+      duration(0), last_t(0), last_cpu_power(0), last_mem_power(0) {}
+
+EnergyAccumulator::EnergyAccumulator (const HWconfig& hw, EnergySource& source)
+    : hw(&hw), tdp(hw), source(&source), energy(0), grams(0), epoch_offset(realtimeNow() - upTime()), cursor(0),
+      duration(0), last_t(0), last_cpu_power(0), last_mem_power(0) {}
+
+/*!
+ *  @brief
+ *  This function adds the energy of a constant power over [t0, t1] and prices it.
+ */
+void EnergyAccumulator::addEnergy (double t0, double t1, double watts) {
+    double joules = watts*(t1 - t0);
+    energy += joules;
+    if (hw->profile && t1 > t0) {
+        double gkwh_s = hw->profile->integral(t0 + epoch_offset, t1 + epoch_offset, cursor);
+        grams += watts * gkwh_s/3.6e6 * hw->pue;
+    }
+    else {
+        grams += hw->carbon_intensity * (joules/3.6e6) * hw->pue;
+    }
+}
+
+/*!
+ *  @brief
+ *  This function adds an instantaneous sample to the accumulator.
+ *
+ *  @param[in] t:         The time of the sample, in seconds (any monotonic origin)
+ *  @param[in] cpu_usage: The CPU usage factor at time t
+ *  @param[in] mem_gb:    The allocated RAM at time t, in GB
+ *
+ *  @details
+ *  The energy between the previous sample and t is integrated with the trapezoidal rule.
+ *  The first sample only sets the origin of the integral.
+ */
+void EnergyAccumulator::push (double t, double cpu_usage, double mem_gb) {
+    double cpu_power = hw->n_cpu * hw->cpu_tdp * cpu_usage;
+    double mem_power = mem_gb * hw->ram_power_usage;
+    if (power_stats.n != 0) {
+        addEnergy(last_t, t, 0.5*(last_cpu_power + cpu_power + last_mem_power + mem_power));
+        duration += t - last_t;
+    }
+    last_t = t;
+    last_cpu_power = cpu_power;
+    last_mem_power = mem_power;
+    cpu_stats.push(cpu_usage);
+    mem_stats.push(mem_gb);
+    power_stats.push(cpu_power + mem_power);
+}
+
+/*!
+ *  @brief
+ *  This function adds a sample whose CPU usage is the average over the interval r.dt ending at t,
+ *  as returned by CPUusageDelta().
+ *
+ *  @param[in] t:      The time of the sample, in seconds (any monotonic origin)
+ *  @param[in] r:      A CPUreading object
+ *  @param[in] mem_gb: The allocated RAM at time t, in GB
+ *
+ *  @details
+ *  The average power of the interval is taken from the EnergySource (TdpModel by default), so
+ *  the CPU energy is exact (interval usage * dt) and the RAM energy follows the trapezoidal rule.
+ *  On the first sample the interval reaches back to the start of the process, and the RAM is
+ *  assumed constant over it.
+ */
+void EnergyAccumulator::push (double t, const CPUreading& r, double mem_gb) {
+    if (source) {
+        push(t, r, mem_gb, source->power(r, mem_gb));
+    }
+    else {
+        push(t, r, mem_gb, tdp);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function adds a sample as push(t, r, mem_gb) does, with the power p of the interval
+ *  already taken from an EnergySource.
+ *
+ *  @param[in] t:      The time of the sample, in seconds (any monotonic origin)
+ *  @param[in] r:      A CPUreading object
+ *  @param[in] mem_gb: The allocated RAM at time t, in GB
+ *  @param[in] p:      The average power over the interval r.dt ending at t
+ */
+void EnergyAccumulator::push (double t, const CPUreading& r, double mem_gb, const PowerSample& p) {
+    addEnergy(t - r.dt, t, p.cpu + p.mem);
+    duration += r.dt;
+    last_t = t;
+    last_cpu_power = p.cpu;
+    last_mem_power = p.mem;
+    cpu_stats.push(r.interval);
+    mem_stats.push(mem_gb);
+    power_stats.push(p.cpu + p.mem);
+}
+
+/*!
+ *  @brief
+ *  This function returns the carbon footprint, in gCO2e, of the energy accumulated so far.
+ *
+ *  @details
+ *  As in carbonFootprint(): carbon_intensity (g/kWh) * energy (kWh) * pue, summed over the
+ *  intervals, with the intensity of the CarbonProfile when one is configured.
+ */
+double EnergyAccumulator::footprint () const {
+    return grams;
+}
+
+/*!
+ *  @brief
+ *  This function loads a carbon intensity profile from the file at PATH.
+ *
+ *  @param[in] PATH: The path of the profile
+ *
+ *  @return true if the file could be read, false otherwise, or if a ".toml" file does not parse
+ *
+ *  @details
+ *  A ".toml" file must hold the key carbon_intensity, an array of [timestamp, value] arrays.
+ *  Any other file is read as CSV, one "timestamp,value" row per line; blank lines, lines
+ *  starting with '#', a header line and rows with an empty field are skipped. Rows need not be
+ *  sorted.
+ */
+bool CarbonProfile::load (const std::string& PATH) {
+    std::vector<std::pair<double, double>> rows;
+
+    if (std::filesystem::path(PATH).extension() == ".toml") {
+        try {
+            toml::arena_scope arena;
+            const ConfigValue profile = toml::parse<toml::compact_regions, toml::arena_map, toml::arena_vector>(PATH, toml::pread_file);
+            for (const auto& row : toml::find<std::vector<std::vector<double>>>(profile, "carbon_intensity")) {
+                if (row.size() == 2) {
+                    rows.emplace_back(row[0], row[1]);
+                }
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+        assign(std::move(rows));
+        return true;
+    }
+
+    std::ifstream in(PATH, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const char* p = content.c_str();
+    const char* end = p + content.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        if (*p != '#') {
+            char* next;
+            double t = std::strtod(p, &next);
+            if (next != p && next < eol && *next == ',') {
+                //strtod() skips leading whitespace, newlines included: a value ending past eol is
+                //read from the next row, and the row is dropped as one with an empty value
+                const char* v_begin = next + 1;
+                double v = std::strtod(v_begin, &next);
+                if (next != v_begin && next <= eol) {
+                    rows.emplace_back(t, v);
+                }
+            }
+        }
+        p = eol + 1;
+    }
+    assign(std::move(rows));
+    return true;
+}
+
+/*!
+ *  @brief
+ *  This function appends the profile to out: the number of steps n, then the n timestamps, values
+ *  and running integrals, as 8-byte values in the byte order of the host.
+ */
+void CarbonProfile::serialize (std::string& out) const {
+    std::uint64_t n = times.size();
+    out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    for (const auto* column : {&times, &values, &cumulative}) {
+        out.append(reinterpret_cast<const char*>(column->data()), n*sizeof(double));
+    }
+}
+
+/*!
+ *  @brief
+ *  This function replaces the profile with the one written by serialize() at p, moving p past it.
+ *
+ *  @return false if [p, end) is too short, in which case the profile is left empty
+ */
+bool CarbonProfile::deserialize (const char*& p, const char* end) {
+    std::uint64_t n;
+    times.clear();
+    values.clear();
+    cumulative.clear();
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(n))) {
+        return false;
+    }
+    std::memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    if (n > static_cast<std::size_t>(end - p)/(3*sizeof(double))) {
+        return false;
+    }
+    for (auto* column : {&times, &values, &cumulative}) {
+        column->resize(n);
+        std::memcpy(column->data(), p, n*sizeof(double));
+        p += n*sizeof(double);
+    }
+    return true;
+}
+
+/*!
+ *  @brief
+ *  This function replaces the profile with the given (timestamp, gCO2/kWh) rows.
+ */
+void CarbonProfile::assign (std::vector<std::pair<double, double>> rows) {
+    if (!std::is_sorted(std::begin(rows), std::end(rows))) {
+        std::stable_sort(std::begin(rows), std::end(rows),
+            [](const std::pair<double, double>& a, const std::pair<double, double>& b) { return a.first < b.first; });
+    }
+    times.resize(rows.size());
+    values.resize(rows.size());
+    cumulative.resize(rows.size());
+    for (std::size_t i = 0; i < rows.size(); i++) {
+        times[i] = rows[i].first;
+        values[i] = rows[i].second;
+        cumulative[i] = (i == 0) ? 0. : cumulative[i-1] + values[i-1]*(times[i] - times[i-1]);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns the index of the step in effect at t, starting the search from cursor
+ *  and leaving it there. Before the first timestamp the index is 0.
+ */
+std::size_t CarbonProfile::find (double t, std::size_t& cursor) const {
+    std::size_t n = times.size();
+    if (cursor >= n) {
+        cursor = 0;
+    }
+    if (times[cursor] <= t) {
+        //common case: the same step or one of the next few
+        for (int k = 0; k < 4 && cursor + 1 < n && times[cursor + 1] <= t; k++) {
+            cursor++;
+        }
+        if (cursor + 1 == n || times[cursor + 1] > t) {
+            return cursor;
+        }
+    }
+    auto it = std::upper_bound(std::begin(times), std::end(times), t);
+    cursor = (it == std::begin(times)) ? 0 : static_cast<std::size_t>(it - std::begin(times)) - 1;
+    return cursor;
+}
+
+/*!
+ *  @brief
+ *  This function returns the intensity, in gCO2/kWh, in effect at the UNIX time t.
+ */
+double CarbonProfile::intensity (double t) const {
+    std::size_t cursor = 0;
+    return intensity(t, cursor);
+}
+
+/*!
+ *  @brief
+ *  As intensity(double), keeping a cursor across calls: O(1) when t moves forward by few steps.
+ */
+double CarbonProfile::intensity (double t, std::size_t& cursor) const {
+    assert(!empty());
+    return values[find(t, cursor)];
+}
+
+double CarbonProfile::primitive (double t, std::size_t& cursor) const {
+    std::size_t i = find(t, cursor);
+    return cumulative[i] + values[i]*(t - times[i]);
+}
+
+/*!
+ *  @brief
+ *  This function returns the integral of the intensity between the UNIX times t0 and t1, in
+ *  gCO2/kWh * s: multiplied by a constant power in W and divided by 3.6e6 it gives gCO2.
+ */
+double CarbonProfile::integral (double t0, double t1, std::size_t& cursor) const {
+    assert(!empty());
+    double a = primitive(t0, cursor);
+    return primitive(t1, cursor) - a;
+}
+
+/*!
+ *  @brief
+ *  This function returns a rough figure of the power absorbed by RAM, per allocated GB.
+ *
+ *  @param[in] family:   The RAM family, e.g. "DDR4"
+ *  @param[in] freq_mhz: The RAM frequency in MHz, 0 if unknown
+ *
+ *  @details
+ *  DDR4, and unknown families (including "COMMON"), get the 0.375 W/GB used by Green
+ *  Algorithms [1]. The other families are estimates, not measurements: the DDR4 figure scaled
+ *  by the square of the core supply voltage, as dynamic power goes with C*V^2*f, with the
+ *  voltages of the JEDEC standards [2]: DDR3 1.5 V, DDR4 1.2 V, DDR5 1.1 V, LPDDR4 1.1 V (VDD2),
+ *  LPDDR5 1.05 V (VDD2H). The figures hold at the reference frequency of each family and are
+ *  scaled linearly with the frequency when it is known.
+ *
+ *  [2] JEDEC JESD79-3 (DDR3), JESD79-4 (DDR4), JESD79-5 (DDR5), JESD209-4 (LPDDR4) and
+ *      JESD209-5 (LPDDR5) SDRAM standards.
+ */
+double dramPowerPerGB (const std::string& family, int freq_mhz) {
+    struct Entry {
+        const char* family;
+        double watts_per_gb;
+        int ref_mhz;
+    };
+    static const Entry table[] = {
+        {"DDR3",   0.586, 1600},                    //0.375 * (1.5/1.2)^2
+        {"DDR4",   0.375, 2133},                    //[1]
+        {"DDR5",   0.315, 4800},                    //0.375 * (1.1/1.2)^2
+        {"LPDDR4", 0.315, 3200},                    //0.375 * (1.1/1.2)^2
+        {"LPDDR5", 0.287, 6400},                    //0.375 * (1.05/1.2)^2
+    };
+    for (const auto& e : table) {
+        if (family == e.family) {
+            return (freq_mhz > 0) ? e.watts_per_gb * freq_mhz / e.ref_mhz : e.watts_per_gb;
+        }
+    }
+    return 0.375;
+}
+
+static bool readCounter (int fd, unsigned long long& value);
+
+/*!
+ *  @brief
+ *  This function opens the current frequency of every core found under hw.cpufreq_root and
+ *  sums their maximum frequencies.
+ *
+ *  @param[in] hw: An HWconfig object, providing cpufreq_root and the TDP parameters
+ */
+CoreFrequency::CoreFrequency (const HWconfig& hw) : hw(&hw), max_freq_sum(0) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(hw.cpufreq_root, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() < 4 || name.compare(0, 3, "cpu") != 0 || !std::isdigit(static_cast<unsigned char>(name[3]))) {
+            continue;
+        }
+        std::string dir = entry.path().string() + "/cpufreq/";
+        int max_fd = open((dir + "cpuinfo_max_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        if (max_fd < 0) {
+            continue;
+        }
+        unsigned long long max_khz = 0;
+        bool ok = readCounter(max_fd, max_khz);
+        close(max_fd);
+        int cur_fd = open((dir + "scaling_cur_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        if (!ok || max_khz == 0 || cur_fd < 0) {
+            if (cur_fd >= 0) {
+                close(cur_fd);
+            }
+            continue;
+        }
+        cur_fds.push_back(cur_fd);
+        max_freq_sum += static_cast<double>(max_khz);
+    }
+}
+
+CoreFrequency::~CoreFrequency () {
+    for (int fd : cur_fds) {
+        close(fd);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns the average clock of the cores over their average maximum clock,
+ *  1 if no core exposes cpufreq.
+ */
+double CoreFrequency::ratio () const {
+    double cur_sum = 0;
+    for (int fd : cur_fds) {
+        unsigned long long khz;
+        if (readCounter(fd, khz)) {
+            cur_sum += static_cast<double>(khz);
+        }
+    }
+    return (max_freq_sum > 0) ? cur_sum / max_freq_sum : 1.;
+}
+
+static bool readCounter (int fd, unsigned long long& value) {
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return false;
+    }
+    value = 0;
+    for (ssize_t i = 0; i < n && buf[i] >= '0' && buf[i] <= '9'; i++) {
+        value = value*10 + static_cast<unsigned long long>(buf[i] - '0');
+    }
+    return true;
+}
+
+/*!
+ *  @brief
+ *  This function opens the energy counters of every package and dram zone found under
+ *  hw.powercap_root.
+ *
+ *  @param[in] hw: An HWconfig object, providing powercap_root and the TdpModel parameters.
+ *
+ *  @details
+ *  Zones are the entries of powercap_root whose name starts with "intel-rapl:": the class
+ *  folder lists sub-zones (e.g. intel-rapl:0:2, usually the dram) next to the packages.
+ *  Zones whose counters cannot be read (they are root-only on recent kernels), or whose
+ *  max_energy_range_uj is missing or unreadable, so that a wraparound cannot be told from a
+ *  reset, are skipped: check domains() after construction.
+ */
+PowercapCounters::PowercapCounters (const HWconfig& hw) : fallback(hw), last_t(-1), package_j(0), dram_j(0) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(hw.powercap_root, ec)) {
+        const auto& folder = entry.path();
+        if (folder.filename().string().rfind("intel-rapl:", 0) != 0) {
+            continue;
+        }
+        std::string name;
+        std::ifstream(folder / "name") >> name;
+        bool package = name.rfind("package", 0) == 0;
+        bool dram = name == "dram";
+        if (!package && !dram) {
+            continue;
+        }
+
+        unsigned long long max_range = 0;
+        std::ifstream(folder / "max_energy_range_uj") >> max_range;
+        if (max_range == 0) {
+            continue;
+        }
+        Zone z{open((folder / "energy_uj").c_str(), O_RDONLY | O_CLOEXEC), dram, max_range, 0};
+        if (z.fd < 0 || !readCounter(z.fd, z.last)) {
+            if (z.fd >= 0) {
+                close(z.fd);
+            }
+            continue;
+        }
+        zones.push_back(z);
+    }
+}
+
+PowercapCounters::~PowercapCounters () {
+    for (const auto& z : zones) {
+        close(z.fd);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns the average power measured by the counters since the previous call.
+ *
+ *  @param[in] r:      A CPUreading object, used by the TdpModel fallback
+ *  @param[in] mem_gb: The allocated RAM, used by the TdpModel fallback
+ *
+ *  @details
+ *  The measured interval is timed with CLOCK_MONOTONIC. A counter lower than its previous
+ *  value has wrapped around max_energy_range_uj.
+ */
+PowerSample PowercapCounters::power (const CPUreading& r, double mem_gb) {
+    PowerSample model = fallback.power(r, mem_gb);
+
+    double now = monotonicNow()*1e-9;
+    double cpu_uj = 0;
+    double mem_uj = 0;
+    bool has_dram = false;
+    for (auto& z : zones) {
+        unsigned long long value;
+        if (!readCounter(z.fd, value)) {
+            continue;
+        }
+        unsigned long long delta = (value >= z.last) ? value - z.last : value + (z.max_range - z.last);
+        z.last = value;
+        if (z.dram) {
+            mem_uj += delta;
+            has_dram = true;
+        }
+        else {
+            cpu_uj += delta;
+        }
+    }
+
+    package_j += cpu_uj*1e-6;
+    dram_j += mem_uj*1e-6;
+
+    double dt = now - last_t;
+    bool first = last_t < 0;
+    last_t = now;
+    if (first || dt <= 0) {
+        return model;
+    }
+    PowerSample p;
+    p.cpu = cpu_uj*1e-6/dt;
+    p.mem = has_dram ? mem_uj*1e-6/dt : model.mem;
+    return p;
+}
+
+template <typename Cpu>
+static std::unique_ptr<EnergySource> withRamModel (const HWconfig& hw) {
+    if (hw.ram_model == "family") {
+        return std::make_unique<ModelSource<Cpu, DramFamily>>(hw);
+    }
+    return std::make_unique<ModelSource<Cpu, RamPerGB>>(hw);
+}
+
+/*!
+ *  @brief
+ *  This function builds the EnergySource selected by hw.energy_source and hw.ram_model.
+ *
+ *  @param[in] hw: An HWconfig object. It is referenced by the source, so it must outlive it.
+ *
+ *  @return A PowercapCounters for "powercap", otherwise a ModelSource with the TdpIdleFloor
+ *  ("tdp_idle"), CoreFrequency ("frequency") or TdpLinear (default) CPU policy and the
+ *  DramFamily ("family") or RamPerGB (default) RAM policy. When no readable counter is found
+ *  under hw.powercap_root, the TdpModel is used and a warning is printed.
+ */
+std::unique_ptr<EnergySource> makeEnergySource (const HWconfig& hw) {
+    if (hw.energy_source == "powercap") {
+        auto counters = std::make_unique<PowercapCounters>(hw);
+        if (counters->domains() != 0) {
+            return counters;
+        }
+        logMessage(LogLevel::warning, "energy", "no readable powercap counter in " + hw.powercap_root + ", using the TDP model");
+        return std::make_unique<TdpModel>(hw);
+    }
+    if (hw.energy_source == "tdp_idle") {
+        return withRamModel<TdpIdleFloor>(hw);
+    }
+    if (hw.energy_source == "frequency") {
+        return withRamModel<CoreFrequency>(hw);
+    }
+    return withRamModel<TdpLinear>(hw);
+}
+
+/*!
+ *  @brief
+ *  This function tells whether makeEnergySource() builds the same source for a and b.
+ *
+ *  @details
+ *  The fields compared are those the sources read once, when they are built: energy_source,
+ *  ram_model, powercap_root and cpufreq_root. The others (TDP, RAM power, ...) are read from
+ *  the HWconfig at each sample, so a reloaded configuration applies to the existing source.
+ */
+bool sameEnergySource (const HWconfig& a, const HWconfig& b) {
+    return a.energy_source == b.energy_source && a.ram_model == b.ram_model &&
+           a.powercap_root == b.powercap_root && a.cpufreq_root == b.cpufreq_root;
+}
+
+/*!
+ *  @brief
+ *  This function returns the part of the power of a set of PIDs that is due to one of them.
+ *
+ *  @param[in] total:        The power of the whole set, e.g. EnergyAccumulator::lastSample()
+ *  @param[in] usage:        The CPU usage factor of the PID over the interval
+ *  @param[in] total_usage:  The CPU usage factor of the whole set over the same interval
+ *  @param[in] mem_gb:       The RAM allocated by the PID, in GB
+ *  @param[in] total_mem_gb: The RAM allocated by the whole set, in GB
+ *
+ *  @details
+ *  The CPU power is split by CPU usage and the RAM power by allocated RAM, so the parts add up
+ *  to the total whatever EnergySource measured it. With the linear models (TdpLinear, RamPerGB,
+ *  DramFamily) a part is what the model gives for the PID alone.
+ */
+PowerSample pidPower (const PowerSample& total, double usage, double total_usage, double mem_gb, double total_mem_gb) {
+    PowerSample p;
+    p.cpu = (total_usage > 0) ? total.cpu * usage/total_usage : 0.;
+    p.mem = (total_mem_gb > 0) ? total.mem * mem_gb/total_mem_gb : 0.;
+    return p;
+}
+
+/*!
+ *  @brief
+ *  This function sets up the monitoring of the calling process.
+ *
+ *  @param[in] hw: An HWconfig object. It is copied.
+ */
+Monitor::Monitor (const HWconfig& hw) : Monitor(hw, getpid()) {}
+
+/*!
+ *  @brief
+ *  This function sets up the monitoring of the process pid.
+ *
+ *  @param[in] hw:  An HWconfig object. It is copied.
+ *  @param[in] pid: The PID of the monitored process
+ */
+Monitor::Monitor (const HWconfig& hw, pid_t pid)
+    : hw(hw), watcher(nullptr), proc_id(pid), stopping(false), final_footprint(0) {
+    latest.store(MonitorSnapshot{});
+}
+
+/*!
+ *  @brief
+ *  This function sets up the monitoring of the process pid with a configuration that follows
+ *  the reloads of watcher: the sampling thread switches to a new snapshot at the next tick,
+ *  keeping the energy and footprint accumulated so far.
+ *
+ *  @param[in] watcher: A ConfigWatcher outliving the Monitor
+ *  @param[in] pid:     The PID of the monitored process
+ */
+Monitor::Monitor (const ConfigWatcher& watcher, pid_t pid)
+    : hw(*watcher.current()), watcher(&watcher), proc_id(pid), stopping(false), final_footprint(0) {
+    latest.store(MonitorSnapshot{});
+}
+
+Monitor::~Monitor () {
+    if (running()) {
+        stop();
+    }
+}
+
+/*!
+ *  @brief
+ *  This function spawns the sampling thread. It has no effect if the monitor is running.
+ */
+void Monitor::start () {
+    if (running()) {
+        return;
+    }
+    stopping = false;
+    worker = std::thread(&Monitor::run, this);
+}
+
+/*!
+ *  @brief
+ *  This function stops the sampling thread after a last sample.
+ *
+ *  @return The carbon footprint, in gCO2e, of the whole monitored run.
+ *
+ *  @details
+ *  It blocks only for the time of the last sample, not for the remaining of the period.
+ */
+double Monitor::stop () {
+    if (running()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+    return final_footprint;
+}
+
+template <typename Source>
+void Monitor::sample (ProcHandle& handle, CPUsage& c, EnergyAccumulator& acc, Source& source) {
+    if (!handle.sample(c)) {
+        return;
+    }
+    c.up_time = upTime();
+    CPUreading r = CPUusageDelta(c, hw);
+    double mem_gb = c.vm_size/1000000;
+    acc.push(c.up_time, r, mem_gb, source);
+
+    MonitorSnapshot snap;
+    snap.up_time = c.up_time;
+    snap.cpu_usage = r.interval;
+    snap.cpu_lifetime = r.lifetime;
+    snap.mem_gb = mem_gb;
+    snap.power = acc.lastPower();
+    snap.joules = acc.joules();
+    snap.elapsed = acc.elapsed();
+    snap.footprint = acc.footprint();
+    snap.samples = acc.power().n;
+    latest.store(snap);
+}
+
+/*!
+ *  @brief
+ *  The body of the sampling thread.
+ *
+ *  @details
+ *  Deadlines are absolute on the steady (monotonic) clock, as in Scheduler, but the thread
+ *  waits on a condition variable so that stop() wakes it up immediately.
+ */
+void Monitor::run () {
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+    ProcHandle handle(hw, proc_id);
+    CPUsage c;
+    auto source = makeEnergySource(hw);
+    EnergyAccumulator acc(hw, *source);
+
+    auto periodOf = [](const HWconfig& hw) {
+        return std::chrono::microseconds(static_cast<long long>(
+            (hw.sampling_period_ms > 0 ? hw.sampling_period_ms : 1000)*1000LL));
+    };
+    auto period = periodOf(hw);
+    auto next = std::chrono::steady_clock::now();
+    std::size_t seen = watcher ? watcher->generation() : 0;
+
+    //the loop is instantiated for the concrete source: no virtual call per sample.
+    //A reload that selects another source leaves it, and it starts again on the new one.
+    bool rebuild = true;
+    while (rebuild) {
+        rebuild = false;
+        visitEnergySource(*source, [&] (auto& power) {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!stopping) {
+                lock.unlock();
+                if (watcher && watcher->generation() != seen) {
+                    //acc and source point to hw: the new values apply from this interval on
+                    seen = watcher->generation();
+                    const HWconfig old = hw;
+                    hw = *watcher->current();
+                    period = periodOf(hw);
+                    if (!sameEnergySource(old, hw)) {
+                        rebuild = true;
+                        return;
+                    }
+                }
+                sample(handle, c, acc, power);
+                lock.lock();
+
+                next += period;
+                auto now = std::chrono::steady_clock::now();
+                if (next <= now) {
+                    next += ((now - next)/period + 1)*period;
+                }
+                wake.wait_until(lock, next, [this]{ return stopping; });
+            }
+            lock.unlock();
+
+            sample(handle, c, acc, power);
+        });
+        if (rebuild) {
+            source = makeEnergySource(hw);
+            acc.setSource(*source);
+        }
+    }
+    final_footprint = acc.footprint();
+}
+
+/*!
+ *  @brief
+ *  This function loads the configuration file at PATH and starts watching it for changes.
+ *
+ *  @param[in] PATH:  The path of the configuration file, as for pullConfig()
+ *  @param[in] cache: Whether loads go through the binary cache of pullConfig()
+ *
+ *  @details
+ *  The first load must succeed: a std::runtime_error is thrown if the file cannot be parsed or
+ *  fails validConfig(). The parent directory is watched rather than the file itself,
+ *  so that editors which save by writing a new file and renaming it over the old one are seen.
+ */
+ConfigWatcher::ConfigWatcher (const std::string& PATH, bool cache)
+    : path(PATH), cache(cache), n_reloads(0), n_rejected(0), inotify_fd(-1), stop_fd(-1) {
+    auto first = std::make_shared<HWconfig>();
+    pullConfig(*first, path, cache);
+    std::string why;
+    if (!validConfig(*first, why)) {
+        throw std::runtime_error(path + ": " + why);
+    }
+    std::atomic_store_explicit(&config, std::shared_ptr<const HWconfig>(std::move(first)), std::memory_order_release);
 
-    auto n_samples = cpu_data.size();
-    
-    auto usage = std::accumulate(std::begin(cpu_data),
-                                 std::end(cpu_data),
-                                 0.);
-    
-    auto mem_alloc = std::accumulate(std::begin(mem_data),
-                                     std::end(mem_data),
-                                     0.);
-    
-    auto avg_CPU_usage = usage/n_samples;
-    auto avg_mem_alloc = mem_alloc/n_samples;
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (inotify_fd < 0 || stop_fd < 0 ||
+        inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        logMessage(LogLevel::warning, "config", "cannot watch " + path + ", configuration reloads are disabled");
+        return;
+    }
+    worker = std::thread(&ConfigWatcher::run, this);
+}
 
-    double core_consumption = hw.n_cpu * hw.cpu_tdp * avg_CPU_usage;
-    double mem_consumption = avg_mem_alloc * hw.ram_power_usage;
-    
-    std::cout << "REQUESTED CORES: " << hw.n_cpu << '\n';
-    std::cout << "TDP_PER_CORE: " << hw.cpu_tdp << '\n';
-    std::cout << "AVG_CPU_USAGE: " << avg_CPU_usage << '\n';
-    std::cout << "AVG_MEM_ALLOC (GB): " << avg_mem_alloc << '\n';
-    std::cout << "RAM W: " << hw.ram_power_usage << '\n';
-    std::cout << "CORE W: " << core_consumption << '\n';
-    std::cout << "MEM W: " << mem_consumption << '\n';
-    std::cout << "ABSORBED W: " << core_consumption + mem_consumption << '\n';
-    std::cout << "ELAPSED T: " << et << '\n';
-    std::cout << "PUE: " << hw.pue << '\n';
-    std::cout << "CARBON INTENSITY: " << hw.carbon_intensity << '\n';
-    
-    return hw.carbon_intensity * (et * (core_consumption + mem_consumption) * hw.pue * 0.001);
-    
+ConfigWatcher::~ConfigWatcher () {
+    if (worker.joinable()) {
+        std::uint64_t one = 1;
+        ssize_t w = write(stop_fd, &one, sizeof(one));
+        (void)w;
+        worker.join();
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    if (stop_fd >= 0) {
+        close(stop_fd);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function parses the configuration file again and, if it is valid, publishes it.
+ *
+ *  @return true if a new snapshot has been published
+ *
+ *  @details
+ *  A file that cannot be parsed or fails validConfig() is rejected and the current snapshot
+ *  stays in place. It is called by the watching thread, but can also be called directly.
+ *  The snapshot carries the RAM power per GB resolved again for its ram_family and ram_freq
+ *  (see decodeConfig()), which the "family" RAM model reads at each sample.
+ */
+bool ConfigWatcher::reload () {
+    std::lock_guard<std::mutex> lock(reload_mtx);
+    auto next = std::make_shared<HWconfig>();
+    std::string why;
+    try {
+        //no exists() check first: the file may go away in between, pullConfig() throws then
+        pullConfig(*next, path, cache);
+        validConfig(*next, why);
+    } catch (const std::exception& e) {
+        why = e.what();
+    }
+    if (!why.empty()) {
+        n_rejected.fetch_add(1, std::memory_order_relaxed);
+        logMessage(LogLevel::warning, "config", path + " rejected (" + why + "), keeping the current configuration");
+        return false;
+    }
+    //the replaced snapshot goes with the last copy of its shared_ptr
+    std::atomic_store_explicit(&config, std::shared_ptr<const HWconfig>(std::move(next)), std::memory_order_release);
+    n_reloads.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void ConfigWatcher::run () {
+    std::string name = std::filesystem::path(path).filename().string();
+    alignas(struct inotify_event) char buffer[4096];
+    struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        bool changed = false;
+        ssize_t n;
+        while ((n = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + n; ) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                if (event->len > 0 && name == event->name) {
+                    changed = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed) {
+            reload();
+        }
+    }
+}
+
+#define SAMPLE_BLOCK_SYNC 0x4B424C4Bu                           //first word of a block header
+
+//bytes of a block of capacity samples: 16-byte header, five 8-byte columns and the pid column padded to 8 bytes
+static std::size_t blockBytes (std::size_t capacity) {
+    return 16 + capacity*(5*8) + ((capacity*4 + 7)/8)*8;
+}
+
+//the block at b, whose header ends with {n, c}
+static SampleBlock blockView (const unsigned char* b) {
+    std::uint32_t nc[2];
+    std::memcpy(nc, b + 8, sizeof(nc));
+    std::size_t c = nc[1];
+    const unsigned char* col = b + 16;
+    SampleBlock v;
+    v.n = nc[0];
+    v.timestamp = reinterpret_cast<const double*>(col);
+    v.utime = reinterpret_cast<const std::uint64_t*>(col + c*8);
+    v.stime = reinterpret_cast<const std::uint64_t*>(col + 2*c*8);
+    v.rss = reinterpret_cast<const std::int64_t*>(col + 3*c*8);
+    v.power = reinterpret_cast<const double*>(col + 4*c*8);
+    v.pid = reinterpret_cast<const std::int32_t*>(col + 5*c*8);
+    return v;
+}
+
+static std::uint32_t blockChecksum (const unsigned char* columns, std::size_t bytes, std::uint32_t n, std::uint32_t c) {
+    std::uint64_t h = imageHash(reinterpret_cast<const char*>(columns), bytes, (static_cast<std::uint64_t>(n) << 32) | c);
+    return static_cast<std::uint32_t>(h ^ (h >> 32));
+}
+
+//writes as much as possible of [p, p + bytes), returns the number of bytes written
+static std::size_t writeAll (int fd, const unsigned char* p, std::size_t bytes) {
+    std::size_t done = 0;
+    while (done != bytes) {
+        ssize_t w = write(fd, p + done, bytes - done);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += static_cast<std::size_t>(w);
+    }
+    return done;
+}
+
+//pads the log with zeros to a multiple of 8 bytes, so that the next block is aligned
+static void alignLog (int fd, std::size_t size) {
+    static const unsigned char zeros[8] = {};
+    if (size % 8 != 0) {
+        writeAll(fd, zeros, 8 - size % 8);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function opens (or creates) the sample log at PATH, appending to it.
+ *
+ *  @param[in] PATH:     The path of the log
+ *  @param[in] capacity: The number of samples per block
+ *
+ *  @details
+ *  The magic is written if the file is empty. A file which is not a log of this version is not
+ *  touched, and the end of a log left misaligned by an interrupted write is padded. Check good()
+ *  after construction.
+ */
+SampleLog::SampleLog (const std::string& PATH, std::size_t capacity)
+    : fd(open(PATH.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644)), capacity(capacity), n(0),
+      block(blockBytes(capacity), 0) {
+    assert(capacity > 0 && capacity <= std::numeric_limits<std::uint32_t>::max());
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        return;
+    }
+    char magic[8];
+    bool ok = (st.st_size == 0) ? writeAll(fd, reinterpret_cast<const unsigned char*>(SAMPLE_LOG_MAGIC), 8) == 8
+                                : pread(fd, magic, 8, 0) == 8 && std::memcmp(magic, SAMPLE_LOG_MAGIC, 8) == 0;
+    if (!ok) {
+        logMessage(LogLevel::warning, "samplelog", PATH + " is not a sample log of this version, samples are not logged");
+        close(fd);
+        fd = -1;
+        return;
+    }
+    alignLog(fd, static_cast<std::size_t>(st.st_size));
+}
+
+SampleLog::~SampleLog () {
+    flush();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function adds a sample to the current block, writing the block out when it is full.
+ *
+ *  @param[in] t:     The time of the sample, in seconds
+ *  @param[in] pid:   The PID of the sampled process
+ *  @param[in] utime: utime, in clock ticks
+ *  @param[in] stime: stime, in clock ticks
+ *  @param[in] rss:   The resident set size, in pages
+ *  @param[in] power: The estimated absorbed power, in W
+ */
+void SampleLog::push (double t, pid_t pid, unsigned long long utime, unsigned long long stime, long rss, double power) {
+    unsigned char* col = block.data() + 16;
+    std::int64_t rss64 = rss;
+    std::int32_t pid32 = pid;
+    std::memcpy(col + n*8, &t, 8);
+    std::memcpy(col + (capacity + n)*8, &utime, 8);
+    std::memcpy(col + (2*capacity + n)*8, &stime, 8);
+    std::memcpy(col + (3*capacity + n)*8, &rss64, 8);
+    std::memcpy(col + (4*capacity + n)*8, &power, 8);
+    std::memcpy(col + 5*capacity*8 + n*4, &pid32, 4);
+    if (++n == capacity) {
+        flush();
+    }
+}
+
+/*!
+ *  @brief
+ *  This function appends the current block to the log. A partial block is written with its
+ *  capacity cut down to its size, so it takes no more room than its samples.
+ */
+void SampleLog::flush () {
+    if (n == 0 || fd < 0) {
+        return;
+    }
+    std::vector<unsigned char> partial;
+    unsigned char* b = block.data();
+    if (n < capacity) {
+        //the columns are moved next to each other, each with n entries
+        partial.assign(blockBytes(n), 0);
+        const unsigned char* from = block.data() + 16;
+        unsigned char* to = partial.data() + 16;
+        for (std::size_t k = 0; k < 5; k++) {
+            std::memcpy(to + k*n*8, from + k*capacity*8, n*8);
+        }
+        std::memcpy(to + 5*n*8, from + 5*capacity*8, n*4);
+        b = partial.data();
+    }
+    std::size_t bytes = (n < capacity) ? partial.size() : block.size();
+    std::uint32_t header[4] = {SAMPLE_BLOCK_SYNC, 0, static_cast<std::uint32_t>(n), static_cast<std::uint32_t>(n < capacity ? n : capacity)};
+    header[1] = blockChecksum(b + 16, bytes - 16, header[2], header[3]);
+    std::memcpy(b, header, sizeof(header));
+    std::size_t written = writeAll(fd, b, bytes);
+    if (written != bytes) {
+        alignLog(fd, written);                      //the reader skips the torn block
+    }
+    n = 0;
+}
+
+/*!
+ *  @brief
+ *  This function maps the sample log at PATH and indexes its blocks.
+ *
+ *  @param[in] PATH: The path of the log
+ *
+ *  @details
+ *  Check good() after construction: it is false if the file cannot be mapped or is not a log.
+ *  A block whose header or checksum does not match, e.g. one torn by an interrupted write, is
+ *  skipped and the scan resumes at the next block header.
+ */
+SampleLogReader::SampleLogReader (const std::string& PATH) : data(nullptr), length(0) {
+    int fd = open(PATH.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= 8) {
+        void* m = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(m);
+            length = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    close(fd);
+    if (data == nullptr) {
+        return;
+    }
+    if (std::memcmp(data, SAMPLE_LOG_MAGIC, 8) != 0) {
+        munmap(const_cast<unsigned char*>(data), length);
+        data = nullptr;
+        return;
+    }
+
+    std::size_t offset = 8;
+    while (offset + 16 <= length) {
+        std::uint32_t h[4];
+        std::memcpy(h, data + offset, sizeof(h));
+        std::size_t bytes = blockBytes(h[3]);
+        if (h[0] == SAMPLE_BLOCK_SYNC && h[3] != 0 && h[2] <= h[3] && bytes <= length - offset &&
+            blockChecksum(data + offset + 16, bytes - 16, h[2], h[3]) == h[1]) {
+            offsets.push_back(offset);
+            offset += bytes;
+        }
+        else {
+            offset += 8;                            //blocks start 8-byte aligned
+        }
+    }
+}
+
+SampleLogReader::~SampleLogReader () {
+    if (data != nullptr) {
+        munmap(const_cast<unsigned char*>(data), length);
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns the i-th block of the log.
+ */
+SampleBlock SampleLogReader::block (std::size_t i) const {
+    return blockView(data + offsets[i]);
+}
+
+/*!
+ *  @brief
+ *  This function returns the total number of samples in the log.
+ */
+std::size_t SampleLogReader::size () const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < blocks(); i++) {
+        total += block(i).n;
+    }
+    return total;
+}
+
+/*!
+ *  @brief
+ *  This function integrates the logged power over time, PID by PID with the trapezoidal rule,
+ *  and returns the total energy in J.
+ *
+ *  @details
+ *  The footprint of the run can then be re-priced with any carbon intensity or PUE as
+ *  carbon_intensity * (joules()/3.6e6) * pue, as in EnergyAccumulator::footprint().
+ */
+double SampleLogReader::joules () const {
+    std::unordered_map<std::int32_t, std::pair<double, double>> last;     //pid -> (t, power)
+    double energy = 0;
+    for (std::size_t i = 0; i < blocks(); i++) {
+        SampleBlock b = block(i);
+        for (std::size_t k = 0; k < b.n; k++) {
+            auto it = last.find(b.pid[k]);
+            if (it != last.end()) {
+                energy += 0.5*(it->second.second + b.power[k])*(b.timestamp[k] - it->second.first);
+                it->second = {b.timestamp[k], b.power[k]};
+            }
+            else {
+                last.emplace(b.pid[k], std::make_pair(b.timestamp[k], b.power[k]));
+            }
+        }
+    }
+    return energy;
+}
+
+/*!
+ *  @brief
+ *  This function opens the listening socket and starts the serving thread.
+ *
+ *  @param[in] address: "localhost:<port>", "127.0.0.1:<port>" or the path of a Unix socket
+ *  @param[in] n:       The number of slots, one per monitored PID
+ *
+ *  @details
+ *  If the socket cannot be set up, a warning is printed and good() is false: publish() still
+ *  works, nothing is served.
+ */
+MetricsExporter::MetricsExporter (const std::string& address, std::size_t n)
+    : address(address), slots(new SeqLock<PidMetrics>[n]), n_slots(n), n_scrapes(0),
+      listen_fd(-1), epoll_fd(-1), stop_fd(-1) {
+    for (std::size_t i = 0; i < n; i++) {
+        slots[i].store(PidMetrics{0, 0, 0, 0});
+    }
+
+    bool tcp = false;
+    long port = 0;
+    for (const char* prefix : {"localhost:", "127.0.0.1:"}) {
+        std::size_t len = std::strlen(prefix);
+        if (address.compare(0, len, prefix) == 0) {
+            const char* digits = address.c_str() + len;
+            char* end = nullptr;
+            errno = 0;
+            port = std::isdigit(static_cast<unsigned char>(*digits)) ? std::strtol(digits, &end, 10) : 0;
+            tcp = true;
+            if (errno != 0 || end == nullptr || *end != '\0' || port < 1 || port > 65535) {
+                logMessage(LogLevel::warning, "metrics", "invalid TCP port in " + address + ", expected 1-65535");
+                return;
+            }
+        }
+    }
+    struct stat st;
+    if (!tcp && lstat(address.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode)) {
+        logMessage(LogLevel::warning, "metrics", "not replacing " + address + ": it exists and is not a socket");
+        return;
+    }
+    if (tcp) {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<std::uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listen_fd >= 0 && bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+    else {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (address.size() < sizeof(addr.sun_path)) {
+            std::memcpy(addr.sun_path, address.c_str(), address.size());
+            unlink(address.c_str());                //a stale socket, checked above
+            unix_path = address;
+            listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        }
+        if (listen_fd >= 0 && bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    bool ready = listen_fd >= 0 && epoll_fd >= 0 && stop_fd >= 0 && listen(listen_fd, 16) == 0 &&
+                 epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == 0;
+    ev.data.fd = stop_fd;
+    if (!ready || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev) != 0) {
+        logMessage(LogLevel::warning, "metrics", "cannot serve metrics on " + address);
+        return;
+    }
+    worker = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter () {
+    if (worker.joinable()) {
+        std::uint64_t one = 1;
+        ssize_t w = write(stop_fd, &one, sizeof(one));
+        (void)w;
+        worker.join();
+    }
+    for (int fd : {listen_fd, epoll_fd, stop_fd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (listen_fd >= 0 && !unix_path.empty()) {
+        unlink(unix_path.c_str());
+    }
+}
+
+/*!
+ *  @brief
+ *  This function returns the current readings of every used slot in the Prometheus text
+ *  exposition format.
+ *
+ *  @details
+ *  Three metrics are served, labelled by pid: kig_power_watts (gauge), kig_energy_joules_total
+ *  and kig_footprint_grams_total (counters).
+ */
+std::string MetricsExporter::render () const {
+    std::vector<PidMetrics> current;
+    current.reserve(n_slots);
+    for (std::size_t i = 0; i < n_slots; i++) {
+        PidMetrics m = slots[i].load();
+        if (m.pid != 0) {
+            current.push_back(m);
+        }
+    }
+
+    struct Family {
+        const char* name;
+        const char* type;
+        const char* help;
+        double PidMetrics::* field;
+    };
+    static const Family families[] = {
+        {"kig_power_watts", "gauge", "Average power absorbed over the last sampling interval, in W.", &PidMetrics::power},
+        {"kig_energy_joules_total", "counter", "Energy absorbed since the monitoring started, in J.", &PidMetrics::joules},
+        {"kig_footprint_grams_total", "counter", "Carbon footprint since the monitoring started, in gCO2e.", &PidMetrics::footprint},
+    };
+
+    std::ostringstream out;
+    out.precision(17);
+    for (const auto& f : families) {
+        out << "# HELP " << f.name << ' ' << f.help << '\n';
+        out << "# TYPE " << f.name << ' ' << f.type << '\n';
+        for (const auto& m : current) {
+            out << f.name << "{pid=\"" << m.pid << "\"} " << m.*(f.field) << '\n';
+        }
+    }
+    return out.str();
+}
+
+/*!
+ *  @brief
+ *  This function reads what the client sent and, once its request is complete, writes the
+ *  response without blocking.
+ *
+ *  @return false when the connection is done (answered or broken) and has to be closed
+ */
+bool MetricsExporter::serve (int fd, Connection& c) {
+    if (c.out.empty()) {
+        char buf[1024];
+        ssize_t n;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            c.in.append(buf, static_cast<std::size_t>(n));
+        }
+        bool open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        if (c.in.find("\r\n\r\n") == std::string::npos && c.in.find("\n\n") == std::string::npos) {
+            return open && c.in.size() <= 8192;
+        }
+        std::string body = render();
+        c.out = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        c.sent = 0;
+        n_scrapes.fetch_add(1, std::memory_order_relaxed);
+    }
+    while (c.sent < c.out.size()) {
+        ssize_t n = send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c.sent += static_cast<std::size_t>(n);
+    }
+    return false;
+}
+
+void MetricsExporter::run () {
+    std::unordered_map<int, Connection> connections;
+    struct epoll_event events[32];
+
+    auto drop = [&](int fd) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    };
+
+    bool stopping = false;
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, events, 32, -1);
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == stop_fd) {
+                stopping = true;
+            }
+            else if (fd == listen_fd) {
+                int client;
+                while ((client = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    struct epoll_event ev = {};
+                    ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+                    ev.data.fd = client;
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &ev) != 0) {
+                        close(client);
+                        continue;
+                    }
+                    connections[client] = Connection{};
+                }
+            }
+            else if (!serve(fd, connections[fd])) {
+                drop(fd);
+            }
+        }
+    }
+    while (!connections.empty()) {
+        drop(connections.begin()->first);
+    }
+}
+
+/*!
+ * @brief This function turns the rows of a LaTeX report written before the records existed back
+ * into records, so that the first renderReport() keeps them.
+ */
+static std::string legacyRecords(const std::string& PATH) {
+	std::ifstream report(PATH);
+	std::string records, line;
+	bool in_table = false;
+	while (std::getline(report, line)) {
+		if (line == "\\hline\\hline") {
+			in_table = true;
+			continue;
+		}
+		if (!in_table || line == "\\hline") {
+			continue;
+		}
+		if (line == "\\end{tabular}") {
+			break;
+		}
+		//name & X & X & et & footprint & X \\, the name may itself contain " & "
+		std::vector<std::string> fields;
+		std::size_t begin = 0, end;
+		while ((end = line.find(" & ", begin)) != std::string::npos) {
+			fields.push_back(line.substr(begin, end - begin));
+			begin = end + 3;
+		}
+		fields.push_back(line.substr(begin));
+		if (fields.size() < 6) {
+			continue;
+		}
+		std::string name = fields[0];
+		for (std::size_t i = 1; i + 5 < fields.size(); i++) {
+			name += " & " + fields[i];
+		}
+		records += name + '\t' + fields[fields.size() - 3] + '\t' + fields[fields.size() - 2] + '\n';
+	}
+	return records;
 }
 
 /*!
- * @brief This function generates the LaTeX report table for carbon footprint of the experiment. The format of the table is:
+ * @brief This function appends the result of a run to the report records. The LaTeX table is then
+ * generated from the records by renderReport(), whose format is:
  * ***Experiment Name | Hardware Specs | Power | Elapsed time | CO2e(g) | Cost***
  *
  * @param[in] hw: A HWconfig object containing infrastructure data
  * @param[in] et: Elapsed time of the computation
  * @param[in] footprint: The carbon footprint of the computation evaluated in carbonFootprint
+ * @param[in] records: The path of the records file, "report.records" by default
+ * @param[in] report: The path of the LaTeX report, "report.txt" by default, only read when the
+ * records file is created
  * 
  * @details 
- * The function is OPTIONAL. After running the function \code{.cpp} std::filesystem::exists("report.txt")\endcode will in any case be TRUE. 
+ * The function is OPTIONAL. After running the function \code{.cpp} std::filesystem::exists(records)\endcode will in any case be TRUE. 
  * 
+ * Each run appends one line, experiment name, elapsed time and footprint separated by tabs, with a
+ * single write() on a descriptor opened with O_APPEND and held under an exclusive flock(): writing a
+ * result costs the same whatever the size of the report, and jobs completing in parallel on a shared
+ * report do not lose rows. Tabs and newlines in the experiment name are replaced by spaces.
+ * When the records file is empty, the rows of an existing report (written by a version of KIG
+ * without records) are imported first. A std::runtime_error is thrown if the record cannot be written.
+ */
+
+void makeReport(HWconfig& hw, double et, double footprint, const std::string& records, const std::string& report) {
+	assert(et != 0 && footprint != 0);
+
+	std::string name = hw.exp_name;
+	std::replace(std::begin(name), std::end(name), '\t', ' ');
+	std::replace(std::begin(name), std::end(name), '\n', ' ');
+	std::string record = name + '\t' + std::to_string(et) + '\t' + std::to_string(footprint) + '\n';
+
+	int fd = open(records.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		throw std::runtime_error("cannot open " + records + ": " + std::strerror(errno));
+	}
+	flock(fd, LOCK_EX);
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size == 0) {
+		record = legacyRecords(report) + record;
+	}
+	ssize_t written = write(fd, record.data(), record.size());
+	int error = errno;
+	flock(fd, LOCK_UN);
+	close(fd);
+	if (written != static_cast<ssize_t>(record.size())) {
+		throw std::runtime_error("cannot append to " + records + ": " + std::strerror(written < 0 ? error : ENOSPC));
+	}
+}
+
+/*!
+ * @brief This function generates the LaTeX report table for carbon footprint of the experiments from the
+ * records appended by makeReport(). The format of the table is:
+ * ***Experiment Name | Hardware Specs | Power | Elapsed time | CO2e(g) | Cost***
+ *
+ * @param[in] records: The path of the records file, "report.records" by default
+ * @param[in] PATH: The path of the LaTeX report, "report.txt" by default
+ *
+ * @return The number of rows of the table.
+ *
+ * @details
  * In the file, the user will find:
  * - LaTeX package dependencies to be included in LaTeX report (if not already included by the user).
  * - LaTeX code following the specified layout.
- * - One row for each run of our experiment. Data will be reported with 2 decimal precision, where needed.
+ * - One row for each run of our experiment, in the order of completion.
+ *
+ * The records are read under a shared flock() and the report is written to a temporary file renamed
+ * over PATH, so readers of the report never see a partial table. Without a records file, i.e. before
+ * the first makeReport(), PATH is left untouched and 0 is returned.
  */
 
-void makeReport(HWconfig& hw, double et, double footprint) {
-	assert(et != 0 && footprint != 0);
-
-	std::string experimental_data = hw.exp_name + " & X & X & "+ 
-									std::to_string(et) + 
-									" & " + 
-									std::to_string(footprint) + 
-									" & " + 
-									"X \\" +
-									"\\";
-	
-	if (!std::filesystem::exists("report.txt")) {
-	
-		std::ofstream report;
-    	report.open("report.txt");
-
-    	report << "##########################################################" << '\n';
-    	report << "IF NOT ALREADY SET, PUT THESE LINES IN YOUR LATEX PREAMBLE" << '\n';
-    	report << "##########################################################" << '\n';
-    	report << "\\usepackage{array}" << '\n';
-    	report << "\\usepackage{textcomp}" << '\n';
-    	report << "\\newcolumntype{P}{>{\\centering\\arraybackslash}m{3cm}}"   << '\n';
-    	report << "##########################################################" << '\n';
-
-    	report << "\\begin{center}" << '\n';
-    	report << "\\begin{tabular}{ c P c c c c }" << '\n';
-    	report << "Experiment & Hardware Specs & Power(W) & Elapsed Time(s) & $CO_2e$(g) & Cost(\\texteuro) \\" << "\\" << '\n';
-    	report << "\\hline\\hline" << '\n';
-		report << experimental_data << '\n';
-    	//report << "X & X & X & " << et << " & " << footprint << " & " << "X \\" << "\\" << '\n';
-    	report << "\\hline" << '\n';
-    	report << "\\end{tabular}" << '\n';
-    	report << "\\end{center}" << '\n';
-
-    	report.close();
+std::size_t renderReport(const std::string& records, const std::string& PATH) {
+	std::vector<std::string> rows;
+	int fd = open(records.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
 	}
-	else {
-		std::fstream read_report;
-		read_report.open("report.txt");
-		std::vector<std::string> buffer;
-		std::string line;
-		while (std::getline(read_report, line)) {
-			buffer.push_back(line);
+	flock(fd, LOCK_SH);
+	std::ifstream read_records(records);
+	std::string line;
+	while (std::getline(read_records, line)) {
+		std::istringstream fields(line);
+		std::string name, et, footprint;
+		if (std::getline(fields, name, '\t') && std::getline(fields, et, '\t') && std::getline(fields, footprint, '\t')) {
+			rows.push_back(name + " & X & X & " + et + " & " + footprint + " & " + "X \\" + "\\");
 		}
-		read_report.close();
-		
-		buffer.insert(std::end(buffer)-2, experimental_data);
-		buffer.insert(std::end(buffer)-2, "\\hline");
-		
-		std::ofstream overwrite_report("report.txt");
-		for (int i=0; i<buffer.size(); i++) {
-			overwrite_report << buffer[i] << '\n';
-		}
-		overwrite_report.close();
 	}
+	flock(fd, LOCK_UN);
+	close(fd);
+
+	std::string tmp_path = PATH + ".tmp." + std::to_string(getpid());
+	std::ofstream report(tmp_path);
+
+	report << "##########################################################" << '\n';
+	report << "IF NOT ALREADY SET, PUT THESE LINES IN YOUR LATEX PREAMBLE" << '\n';
+	report << "##########################################################" << '\n';
+	report << "\\usepackage{array}" << '\n';
+	report << "\\usepackage{textcomp}" << '\n';
+	report << "\\newcolumntype{P}{>{\\centering\\arraybackslash}m{3cm}}"   << '\n';
+	report << "##########################################################" << '\n';
+
+	report << "\\begin{center}" << '\n';
+	report << "\\begin{tabular}{ c P c c c c }" << '\n';
+	report << "Experiment & Hardware Specs & Power(W) & Elapsed Time(s) & $CO_2e$(g) & Cost(\\texteuro) \\" << "\\" << '\n';
+	report << "\\hline\\hline" << '\n';
+	for (const auto& row : rows) {
+		report << row << '\n';
+		report << "\\hline" << '\n';
+	}
+	report << "\\end{tabular}" << '\n';
+	report << "\\end{center}" << '\n';
+	report.close();
+
+	std::filesystem::rename(tmp_path, PATH);
+	return rows.size();
+}
+
+static std::mutex log_mtx;
+static LogSink log_sink = streamLogSink(std::cerr);
+static std::atomic<int> log_threshold(static_cast<int>(LogLevel::warning));
+
+/*!
+ *  @brief
+ *  This function returns a sink printing each record on a line of os, as "KIG <key>: <value>".
+ *
+ *  @param[in] os: The stream, which must outlive the sink
+ */
+LogSink streamLogSink (std::ostream& os) {
+    return [&os](const LogRecord& r) {
+        os << "KIG " << r.key << ": ";
+        if (r.text) {
+            os << r.text << '\n';
+        }
+        else {
+            os << r.value << '\n';
+        }
+    };
+}
+
+/*!
+ *  @brief
+ *  This function replaces the destination of the log records of the library.
+ *
+ *  @param[in] sink:  The function called with every record at or above level, nullptr for none
+ *  @param[in] level: The lowest level delivered to sink
+ *
+ *  @details
+ *  By default warnings and errors are printed on std::cerr and nothing else is produced, so
+ *  the numerical functions have no output cost. Records are delivered one at a time, under
+ *  a mutex, on the thread that produced them.
+ */
+void setLogSink (LogSink sink, LogLevel level) {
+    std::lock_guard<std::mutex> lock(log_mtx);
+    log_sink = std::move(sink);
+    log_threshold.store(static_cast<int>(log_sink ? level : LogLevel::off), std::memory_order_relaxed);
+}
+
+/*!
+ *  @brief
+ *  This function tells whether records of the given level are delivered, so that callers can
+ *  skip preparing them. It costs one relaxed atomic load.
+ */
+bool logEnabled (LogLevel level) {
+    return level != LogLevel::off && static_cast<int>(level) >= log_threshold.load(std::memory_order_relaxed);
+}
+
+/*!
+ *  @brief
+ *  This function delivers a numeric record to the sink, if its level is enabled.
+ */
+void logValue (LogLevel level, const char* key, double value) {
+    if (!logEnabled(level)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(log_mtx);
+    if (log_sink) {
+        log_sink(LogRecord{level, key, value, nullptr});
+    }
+}
+
+/*!
+ *  @brief
+ *  This function delivers a message to the sink, if its level is enabled.
+ */
+void logMessage (LogLevel level, const char* key, const std::string& text) {
+    if (!logEnabled(level)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(log_mtx);
+    if (log_sink) {
+        log_sink(LogRecord{level, key, 0, text.c_str()});
+    }
 }
 
 std::ostream& operator<< (std::ostream& of, std::vector<double> v) {
@@ -8,20 +8,72 @@
 
 #include <sys/types.h>
 #include <sys/sysinfo.h>
+#include <sys/resource.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <cassert>
+#include <cerrno>
 #include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector> 
+#include <unordered_map>
 #include <numeric>
+#include <algorithm>
 #include <tuple>
+#include <array>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <type_traits>
+#include <functional>
+#include <stdexcept>
 #include <filesystem>
 #include <limits>
 #include <toml.hpp>
 
+#define STAT_BUFFER_SIZE 1024                                   //one /proc/<pid>/stat line fits comfortably.
+#define STATUS_BUFFER_SIZE 4096                                 //whole /proc/<pid>/status file.
+
+class CarbonProfile;
+
+#define CONFIG_CACHE_MAGIC "KIGCFG01"
+#define CONFIG_CACHE_SUFFIX ".kigcache"                         //appended to the path of the TOML file
+
+/**
+ *  @brief toml value tree of the configuration files, without comments and with the location
+ *  of each value kept as offsets into the file (toml::compact_regions), which saves a region
+ *  allocation per value; each value still holds a reference-counted pointer to the file content.
+ *  Its tables and arrays are allocated from the monotonic arena of the enclosing
+ *  toml::arena_scope, so a whole configuration is built with a few block allocations and
+ *  released at once.
+*/
+using ConfigValue = toml::basic_value<toml::compact_regions, toml::arena_map, toml::arena_vector>;
+
 /**
  *  @brief This data structure contains the information fetched from the
  *  TOML configuration file. To assure simplicity and continuity, field names are replicating the keys of the TOML file.
@@ -38,7 +90,21 @@ struct HWconfig {
     int clock_ticks;                /**< Clock ticks for conversion from jiffies to seconds (from getconf CLK_TCK)     */
     double carbon_intensity;        /**< Carbon cost (by region) of producing electrical power                         */
     double pue;                     /**< Power usage effectiveness metric for the PC or computing facility             */
-    double ram_power_usage;         /**< Watts used by RAM                                                             */
+    double ram_power_usage;         /**< Watts used by RAM, per GB                                                     */
+    double cpu_idle_power;          /**< Watts absorbed by an idle chip, used by the "tdp_idle" model                  */
+    double dram_power_per_gb = -1;  /**< dramPowerPerGB(ram_family, ram_freq), set by pullConfig(), < 0 if not resolved */
+    int ram_freq;                   /**< RAM frequency in MHz, 0 if not set                                            */
+    std::string ram_family;         /**< RAM family, e.g. DDR4                                                         */
+    std::string ram_model;          /**< How RAM power is obtained: "fixed" (ram_power_usage) or "family" (table)      */
+    std::string cpufreq_root;       /**< Path of the cpufreq sysfs folder, usually /sys/devices/system/cpu/            */
+    int sampling_period_ms;         /**< Sampling period in milliseconds, 0 if not set (the caller picks a default)    */
+    std::string energy_source;      /**< CPU power model: "tdp", "tdp_idle", "frequency" or "powercap" (RAPL counters) */
+    std::string powercap_root;      /**< Path of the powercap sysfs folder, usually /sys/class/powercap/               */
+    std::string sample_log;         /**< Path of the binary log of every sample, empty if not logging                  */
+    int sampler_threads;            /**< Worker threads of the ShardedSampler, 0 for one per NUMA node                 */
+    std::string metrics;            /**< Address served by the MetricsExporter, empty if not exporting                 */
+    std::string carbon_profile;     /**< Path of the carbon intensity time series, empty if carbon_intensity is fixed  */
+    std::shared_ptr<const CarbonProfile> profile;  /**< The time series loaded from carbon_profile, if any             */
     std::string exp_name;			/**< Name of the computing experiment being run									   */
     std::string arch;               /**< Architecture of CPU on board                                                  */
     std::string root_folder;        /**< Path of the folder containing process related data, usually /proc/            */
@@ -47,6 +113,184 @@ struct HWconfig {
 
 };
 
+/**
+ *  @brief Decodes a scalar of a configuration into out, without throwing.
+ *  @return false if the value has another type (or, for int, does not fit)
+*/
+inline bool decodeScalar (const ConfigValue& v, int& out) {
+    if (!v.is_integer() || v.as_integer() < std::numeric_limits<int>::min() || v.as_integer() > std::numeric_limits<int>::max()) {
+        return false;
+    }
+    out = static_cast<int>(v.as_integer());
+    return true;
+}
+
+inline bool decodeScalar (const ConfigValue& v, double& out) {
+    if (v.is_floating()) {
+        out = v.as_floating();
+    } else if (v.is_integer()) {                        //"pue = 1" is a valid efficiency
+        out = static_cast<double>(v.as_integer());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline bool decodeScalar (const ConfigValue& v, std::string& out) {
+    if (!v.is_string()) {
+        return false;
+    }
+    out = v.as_string().str;
+    return true;
+}
+
+/**
+ *  @brief One entry of a ConfigSchema: the member of Config that table.key of the TOML file
+ *  is stored into, the value it takes when the key is missing and the values it rejects.
+*/
+template <typename Config, typename T>
+struct ConfigField {
+    using Fallback = T (*)(const Config&);
+    using Check = const char* (*)(const T&);
+
+    std::string_view table;                         /**< Top-level table holding the key              */
+    std::string_view key;                           /**< Key in that table                            */
+    T Config::* member;                             /**< Where the value is stored                    */
+    Fallback fallback;                              /**< Value of a missing key, nullptr if required  */
+    Check check;                                    /**< Why a value is rejected, nullptr if it is ok */
+};
+
+template <typename Config, typename T>
+constexpr ConfigField<Config, T> requiredField (std::string_view table, std::string_view key, T Config::* member,
+                                                typename ConfigField<Config, T>::Check check = nullptr) {
+    return {table, key, member, nullptr, check};
+}
+
+/**
+ *  @brief A field that may be missing. fallback is called after all the keys have been read, so
+ *  it can depend on the other fields.
+*/
+template <typename Config, typename T>
+constexpr ConfigField<Config, T> optionalField (std::string_view table, std::string_view key, T Config::* member,
+                                                typename ConfigField<Config, T>::Fallback fallback,
+                                                typename ConfigField<Config, T>::Check check = nullptr) {
+    return {table, key, member, fallback, check};
+}
+
+/**
+ *  @brief A compile-time table of ConfigFields that fills a Config from a parsed TOML file.
+ *
+ *  decode() walks the key/value pairs of the tables named in the schema once, matching each
+ *  key against the fields, then applies the fallbacks and the checks. It does not throw: every
+ *  missing key, mistyped value and rejected value is reported, as "table.key message".
+*/
+template <typename Config, typename... T>
+class ConfigSchema {
+public:
+    constexpr explicit ConfigSchema (ConfigField<Config, T>... f) : fields(f...), tables{f.table...}, keys{f.key...} {}
+
+    std::vector<std::string> decode (const ConfigValue& root, Config& out) const {
+        std::vector<std::string> errors;
+        enum State : unsigned char { missing, read, mistyped };
+        std::array<State, sizeof...(T)> state{};
+        if (!root.is_table()) {
+            errors.push_back("the configuration is not a table");
+            return errors;
+        }
+        for (const auto& section : root.as_table()) {
+            std::array<bool, sizeof...(T)> in_section{};
+            bool any = false;
+            for (std::size_t i = 0; i < sizeof...(T); i++) {
+                any |= in_section[i] = (tables[i] == section.first);
+            }
+            if (!any || !section.second.is_table()) {
+                continue;
+            }
+            for (const auto& entry : section.second.as_table()) {
+                const std::string_view key = entry.first;
+                for (std::size_t i = 0; i < sizeof...(T); i++) {
+                    if (in_section[i] && state[i] == missing && keys[i] == key) {
+                        if (decoders(std::index_sequence_for<T...>{})[i](*this, entry.second, out)) {
+                            state[i] = read;
+                        } else {
+                            state[i] = mistyped;
+                            errors.push_back(std::string(tables[i]) + "." + std::string(key) + " has type "
+                                             + toml::stringize(entry.second.type()));
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        forEach([&] (const auto& f, std::size_t i) {
+            if (state[i] == mistyped) {
+                return;
+            }
+            if (state[i] == missing) {
+                if (f.fallback == nullptr) {
+                    errors.push_back(name(f) + " is missing");
+                    return;
+                }
+                out.*f.member = f.fallback(out);
+            }
+            if (f.check != nullptr) {
+                if (const char* why = f.check(out.*f.member)) {
+                    errors.push_back(name(f) + " " + why);
+                }
+            }
+        });
+        return errors;
+    }
+
+    /**
+     *  @brief Runs the checks of the fields on an already decoded Config.
+     *  @return the first rejection as "key message", empty if there is none
+    */
+    std::string check (const Config& c) const {
+        std::string first;
+        forEach([&] (const auto& f, std::size_t) {
+            const char* why = (f.check != nullptr && first.empty()) ? f.check(c.*f.member) : nullptr;
+            if (why != nullptr) {
+                first = std::string(f.key) + " " + why;
+            }
+        });
+        return first;
+    }
+
+    /**
+     *  @brief Calls fn on every ConfigField, in the order of the schema.
+    */
+    template <typename F>
+    void visit (F&& fn) const { forEach([&] (const auto& f, std::size_t) { fn(f); }); }
+
+private:
+    template <typename Field>
+    static std::string name (const Field& f) { return std::string(f.table) + "." + std::string(f.key); }
+
+    using Decoder = bool (*)(const ConfigSchema&, const ConfigValue&, Config&);
+
+    template <std::size_t I>
+    static bool decodeField (const ConfigSchema& s, const ConfigValue& v, Config& out) {
+        return decodeScalar(v, out.*std::get<I>(s.fields).member);
+    }
+
+    //indexed by field, so a matched key is decoded without visiting the other fields
+    template <std::size_t... I>
+    static constexpr std::array<Decoder, sizeof...(T)> decoders (std::index_sequence<I...>) {
+        return {&decodeField<I>...};
+    }
+
+    template <typename F>
+    void forEach (F&& fn) const { forEach(fn, std::index_sequence_for<T...>{}); }
+
+    template <typename F, std::size_t... I>
+    void forEach (F& fn, std::index_sequence<I...>) const { (fn(std::get<I>(fields), I), ...); }
+
+    std::tuple<ConfigField<Config, T>...> fields;
+    std::array<std::string_view, sizeof...(T)> tables;      //the same as in fields, to match keys in a plain loop
+    std::array<std::string_view, sizeof...(T)> keys;
+};
+
 /**
  *  @brief The data structure containing the information regarding computational
  *  activity drawn from /proc/ level information. Each field replicates the formal
@@ -58,27 +302,896 @@ struct CPUsage {
     //the properties of this structure follow the meaningful entries of /proc/pid/stat file
     //for this specific task, fields number 14, 15 and 22 are required.
     //so we will look for [13], [14], [21] positions.
+    //parseStat() also keeps fields 20 (num_threads) and 24 (rss).
     //For technical continuity and readability, the name will be kept as defined in man7.org
     //uptime is derived from system.
     //be aware that UPTIME is given in SECONDS, while *TIME params are given in
     //SYSTEM CLOCK_TICKS (or jiffies if you want to be edgy).
 
-    double utime;                                   /**< Time used by the process in user mode       */
-    double stime;                                   /**< Time used by the process in kernel mode     */
-    double starttime;                               /**< Time at which the job was started           */
+    unsigned long long utime;                       /**< Time used by the process in user mode       */
+    unsigned long long stime;                       /**< Time used by the process in kernel mode     */
+    unsigned long long starttime;                   /**< Time at which the job was started           */
+    long rss;                                       /**< Resident set size, in pages                 */
+    long num_threads;                               /**< Number of threads in the process            */
     double up_time;                                 /**< Time elapsed since last boot                */
     double elapsed_time;                            /**< Time elapsed, in seconds, by computation    */
     double vm_size;                                 /**< Size in kB of allocated RAM                 */
 
+    //counters of the previous call to CPUusageDelta(), prev_up_time == 0 before the first one.
+    unsigned long long prev_utime = 0;              /**< utime at the previous sample                */
+    unsigned long long prev_stime = 0;              /**< stime at the previous sample                */
+    double prev_up_time = 0;                        /**< up_time at the previous sample              */
+
+};
+
+/**
+ *  @brief The CPU usage factor of a process, both over the last sampling interval and
+ *  over its whole lifetime, as returned by CPUusageDelta().
+*/
+struct CPUreading {
+
+    double interval;                                /**< Usage factor over the last interval         */
+    double lifetime;                                /**< Usage factor since the process started      */
+    double dt;                                      /**< Length of the last interval, in seconds     */
+
+};
+
+/**
+ *  @brief The memory related entries of /proc/<pid>/status, all in kB except threads.
+ *  Kernel threads have no Vm* or Rss* entries, in which case those fields stay 0.
+*/
+struct MemStatus {
+
+    long vm_size;                                   /**< VmSize: total virtual memory                */
+    long vm_rss;                                    /**< VmRSS: resident set size                    */
+    long vm_hwm;                                    /**< VmHWM: peak resident set size               */
+    long rss_anon;                                  /**< RssAnon: resident anonymous memory          */
+    long rss_file;                                  /**< RssFile: resident file mappings             */
+    long vm_swap;                                   /**< VmSwap: swapped-out anonymous memory        */
+    long threads;                                   /**< Threads: number of threads                  */
+
+};
+
+/**
+ *  @brief A per-PID handle keeping /proc/<pid>/stat and /proc/<pid>/status open across samples.
+ *
+ *  Paths are built once from the HWconfig (root_folder + pid + cpu_stat_file/mem_stat_file),
+ *  then every sample() re-reads both files with pread(fd, buf, n, 0): two syscalls per sample,
+ *  no path strings, no filesystem::exists. Once the process is retired the kernel fails the
+ *  reads (ESRCH), sample() returns false and the handle stays dead.
+*/
+class ProcHandle {
+public:
+    ProcHandle (const HWconfig&, pid_t);
+    ProcHandle (const ProcHandle&) = delete;
+    ProcHandle& operator= (const ProcHandle&) = delete;
+    ProcHandle (ProcHandle&&) noexcept;
+    ProcHandle& operator= (ProcHandle&&) noexcept;
+    ~ProcHandle ();
+
+    bool sample (CPUsage&);
+    bool sample (CPUsage&, MemStatus&);
+    bool alive () const { return stat_fd >= 0; }
+    pid_t pid () const { return proc_id; }
+
+private:
+    void release ();
+
+    pid_t proc_id;
+    int stat_fd;
+    int status_fd;
+};
+
+/**
+ *  @brief A process tree rooted at one PID, whose descendants are discovered while sampling.
+ *
+ *  Children are read from /proc/<pid>/task/<tid>/children (kernels built with
+ *  CONFIG_PROC_CHILDREN), so forked workers or MPI ranks spawned after the start are picked
+ *  up automatically. Discovery is incremental: the task directory of a process is listed
+ *  again only when its thread count changes or a task disappears, and the children list of
+ *  a task is parsed only when its content changes. CPU ticks of retired descendants are kept,
+ *  so the whole tree is accounted for.
+*/
+class ProcessTree {
+public:
+    ProcessTree (const HWconfig&, pid_t);
+    ProcessTree (const ProcessTree&) = delete;
+    ProcessTree& operator= (const ProcessTree&) = delete;
+    ~ProcessTree ();
+
+    bool sample (CPUsage&, MemStatus&);
+    std::size_t size () const { return nodes.size(); }
+
+private:
+    struct Node {
+        ProcHandle handle;
+        std::vector<int> children_fds;              //one /proc/<pid>/task/<tid>/children per task
+        long n_tasks;
+        std::string children;                       //last content of the children files
+        unsigned long long utime;
+        unsigned long long stime;
+    };
+
+    void addNode (pid_t);
+    void removeNode (pid_t);
+    void scanTasks (pid_t, Node&);
+    void scanChildren (Node&);
+
+    const HWconfig& hw;
+    pid_t root;
+    std::unordered_map<pid_t, Node> nodes;
+    std::vector<pid_t> worklist;
+    std::string scratch;
+    unsigned long long retired_utime;
+    unsigned long long retired_stime;
+};
+
+/**
+ *  @brief A sampler for a fixed set of PIDs, reading all of them once per tick.
+ *
+ *  The clocks (upTime() and CLOCK_MONOTONIC) are read once per tick, not once per PID, then every
+ *  ProcHandle is sampled in a tight loop. Results are stored as a structure of arrays indexed
+ *  by the slot of the PID (the order given to the constructor), so that aggregations over
+ *  thousands of PIDs are plain loops over contiguous arrays. Retired PIDs keep their last
+ *  utime/stime, while their rss and vm_size drop to 0.
+*/
+class Sampler {
+public:
+    Sampler (const HWconfig&, const std::vector<pid_t>&);
+
+    std::size_t tick ();
+
+    std::size_t size () const { return handles.size(); }
+    pid_t pid (std::size_t slot) const { return handles[slot].pid(); }
+    double timestamp () const { return now; }
+    double up_time () const { return uptime; }
+
+    const std::vector<unsigned long long>& utime () const { return utime_; }
+    const std::vector<unsigned long long>& stime () const { return stime_; }
+    const std::vector<unsigned long long>& starttime () const { return starttime_; }
+    const std::vector<long>& rss () const { return rss_; }
+    const std::vector<long>& vm_size () const { return vm_size_; }
+    const std::vector<unsigned char>& alive () const { return alive_; }
+
+    unsigned long long totalTicks () const;
+    double totalVmSize () const;
+    double totalUsage (const HWconfig&) const;
+    double totalIntervalUsage (const HWconfig&) const;
+    double intervalUsage (std::size_t, const HWconfig&) const;
+    double interval () const { return prev_uptime > 0 ? uptime - prev_uptime : 0.; }
+
+private:
+    std::vector<ProcHandle> handles;
+    std::vector<unsigned long long> utime_;
+    std::vector<unsigned long long> stime_;
+    std::vector<unsigned long long> starttime_;
+    std::vector<long> rss_;                         //pages
+    std::vector<long> vm_size_;                     //kB
+    std::vector<unsigned char> alive_;
+    std::vector<unsigned long long> prev_utime;
+    std::vector<unsigned long long> prev_stime;
+    double now;                                     //CLOCK_MONOTONIC, seconds
+    double uptime;                                  //from upTime(), seconds
+    double prev_uptime;
+};
+
+/**
+ *  @brief A Sampler split in shards, each sampled by its own worker thread, for PID sets too
+ *  large to be read sequentially within the sampling period.
+ *
+ *  The PIDs are partitioned in contiguous shards, one per worker; each shard is a Sampler, with
+ *  its own ProcHandles, and its worker also computes the shard totals right after sampling. The
+ *  totals are merged, by summing them, only when they are read. By default there is one worker
+ *  per online NUMA node, pinned to the CPUs of its node. tick() returns when every shard is done.
+*/
+class ShardedSampler {
+public:
+    ShardedSampler (const HWconfig&, const std::vector<pid_t>&, std::size_t = 0);
+    ShardedSampler (const ShardedSampler&) = delete;
+    ShardedSampler& operator= (const ShardedSampler&) = delete;
+    ~ShardedSampler ();
+
+    std::size_t tick ();
+
+    std::size_t size () const { return n_pids; }
+    std::size_t shards () const { return parts.size(); }
+    const Sampler& shard (std::size_t i) const { return parts[i]->sampler; }
+    std::size_t offset (std::size_t i) const { return parts[i]->offset; }
+    double up_time () const { return parts.front()->sampler.up_time(); }
+    double interval () const { return parts.front()->sampler.interval(); }
+
+    unsigned long long totalTicks () const;
+    double totalVmSize () const;
+    double totalUsage () const;
+    double totalIntervalUsage () const;
+
+private:
+    struct Shard {
+        Shard (const HWconfig& hw, const std::vector<pid_t>& pids, std::size_t offset)
+            : sampler(hw, pids), offset(offset), live(0), ticks(0), vm_size(0), usage(0), interval_usage(0) {}
+
+        Sampler sampler;
+        std::size_t offset;                         //slot of the first PID in the whole set
+        std::vector<int> cpus;                      //affinity of the worker, empty for none
+        std::size_t live;
+        unsigned long long ticks;
+        double vm_size;
+        double usage;
+        double interval_usage;
+    };
+
+    void run (std::size_t);
+    void sampleShard (Shard&);
+
+    const HWconfig* hw;
+    std::size_t n_pids;
+    std::vector<std::unique_ptr<Shard>> parts;
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    std::size_t generation;
+    std::size_t pending;
+    bool stopping;
+};
+
+/**
+ *  @brief Running count, mean, variance (Welford) and extrema of a sampled quantity, in O(1) memory.
+*/
+struct RunningStats {
+
+    std::size_t n = 0;                              /**< Number of samples                           */
+    double mean = 0;                                /**< Running mean                                */
+    double m2 = 0;                                  /**< Sum of squared deviations from the mean     */
+    double min = std::numeric_limits<double>::infinity();   /**< Smallest sample                     */
+    double max = -std::numeric_limits<double>::infinity();  /**< Largest sample                      */
+
+    void push (double);
+    double variance () const { return n > 1 ? m2/(n - 1) : 0.; }
+
+};
+
+/**
+ *  @brief The power absorbed over a sampling interval, in Watts, split between cores and RAM.
+*/
+struct PowerSample {
+
+    double cpu;                                     /**< Power absorbed by the CPU packages          */
+    double mem;                                     /**< Power absorbed by the RAM                   */
+
+};
+
+/**
+ *  @brief The interface of the sources of absorbed power used by EnergyAccumulator.
+ *
+ *  power() is called once per sample and returns the average power over the interval
+ *  described by the CPUreading (r.dt seconds ending now).
+*/
+class EnergySource {
+public:
+    virtual ~EnergySource () = default;
+    virtual PowerSample power (const CPUreading&, double) = 0;
+};
+
+double dramPowerPerGB (const std::string&, int);
+
+/*
+ *  Power model policies. A CPU policy turns a CPUreading into the average power of the cores,
+ *  a RAM policy turns the allocated GB into the power of the memory. ModelSource combines one
+ *  of each, so every pair is compiled into its own power() with the policies inlined; the pair
+ *  is picked from energy.source and energy.ram_model by makeEnergySource(). The HWconfig is
+ *  referenced, so it must outlive the policies.
+ */
+
+/**
+ *  @brief The Green Algorithms CPU model [1]: n_cpu * cpu_tdp * cpu_usage.
+*/
+struct TdpLinear {
+    explicit TdpLinear (const HWconfig& hw) : hw(&hw) {}
+    double operator() (const CPUreading& r) const { return hw->n_cpu * hw->cpu_tdp * r.interval; }
+
+    const HWconfig* hw;
+};
+
+/**
+ *  @brief A linear model with an idle floor: each chip absorbs cpu_idle_power when idle and
+ *  grows linearly to cpu_tdp at full load. It reduces to TdpLinear when cpu_idle_power is 0.
+*/
+struct TdpIdleFloor {
+    explicit TdpIdleFloor (const HWconfig& hw) : hw(&hw) {}
+    double operator() (const CPUreading& r) const {
+        return hw->n_cpu * (hw->cpu_idle_power + (hw->cpu_tdp - hw->cpu_idle_power) * r.interval);
+    }
+
+    const HWconfig* hw;
+};
+
+/**
+ *  @brief The linear model scaled by the current clock of the cores: n_cpu * cpu_tdp * cpu_usage
+ *  * f/f_max, with f and f_max averaged over the cpufreq folders found under cpufreq_root.
+ *
+ *  The scaling_cur_freq files are kept open and re-read at each sample. Without cpufreq (e.g.
+ *  in most virtual machines) the ratio is 1 and the model is TdpLinear.
+*/
+class CoreFrequency {
+public:
+    explicit CoreFrequency (const HWconfig&);
+    CoreFrequency (const CoreFrequency&) = delete;
+    CoreFrequency& operator= (const CoreFrequency&) = delete;
+    ~CoreFrequency ();
+
+    double operator() (const CPUreading& r) const { return hw->n_cpu * hw->cpu_tdp * r.interval * ratio(); }
+    double ratio () const;
+    std::size_t cores () const { return cur_fds.size(); }
+
+private:
+    const HWconfig* hw;
+    std::vector<int> cur_fds;                       //scaling_cur_freq, one per core
+    double max_freq_sum;                            //sum of cpuinfo_max_freq, kHz
+};
+
+/**
+ *  @brief The Green Algorithms RAM model [1]: mem_gb * ram_power_usage.
+*/
+struct RamPerGB {
+    explicit RamPerGB (const HWconfig& hw) : hw(&hw) {}
+    double operator() (double mem_gb) const { return mem_gb * hw->ram_power_usage; }
+
+    const HWconfig* hw;
 };
 
-void pullConfig (HWconfig&, std::string);
+/**
+ *  @brief The RAM power per GB of ram_family at ram_freq, from dramPowerPerGB(). It is read from
+ *  dram_power_per_gb at each sample, so it follows the configurations reloaded by pullConfig();
+ *  an HWconfig filled by hand is looked up once, when the model is built.
+*/
+struct DramFamily {
+    explicit DramFamily (const HWconfig& hw) : hw(&hw), lookup(dramPowerPerGB(hw.ram_family, hw.ram_freq)) {}
+    double operator() (double mem_gb) const { return mem_gb * (hw->dram_power_per_gb >= 0 ? hw->dram_power_per_gb : lookup); }
+
+    const HWconfig* hw;
+    double lookup;
+};
+
+/**
+ *  @brief An EnergySource computing power with a CPU policy and a RAM policy. The RAM power is
+ *  averaged over the interval (trapezoidal rule), the CPU power already is an interval average.
+*/
+template <typename Cpu, typename Ram>
+class ModelSource final : public EnergySource {
+public:
+    explicit ModelSource (const HWconfig& hw) : cpu(hw), ram(hw), last_mem_power(-1) {}
+
+    PowerSample power (const CPUreading& r, double mem_gb) override {
+        double mem_power = ram(mem_gb);
+        PowerSample p;
+        p.cpu = cpu(r);
+        p.mem = (last_mem_power >= 0) ? 0.5*(last_mem_power + mem_power) : mem_power;
+        last_mem_power = mem_power;
+        return p;
+    }
+
+    const Cpu& cpuModel () const { return cpu; }
+
+private:
+    Cpu cpu;
+    Ram ram;
+    double last_mem_power;
+};
+
+/**
+ *  @brief The Green Algorithms model [1], the default EnergySource.
+*/
+using TdpModel = ModelSource<TdpLinear, RamPerGB>;
+
+/**
+ *  @brief Measured energy from the RAPL counters exposed by the powercap framework: the
+ *  energy_uj file of every intel-rapl zone found in powercap_root.
+ *
+ *  Zones named package-N are accounted as CPU, zones named dram as RAM; other zones (core,
+ *  uncore, psys) are already included in a package or would count twice. Counter wraparound
+ *  is handled through max_energy_range_uj, and zones without it are skipped. The counters measure whole packages, so the reading
+ *  is meaningful when the monitored job owns the node. The counters cannot reach back before
+ *  the first sample, so the first interval, and the RAM when no dram zone exists, are estimated
+ *  with the TdpModel. packageJoules() and dramJoules() are the measured energies alone.
+*/
+class PowercapCounters final : public EnergySource {
+public:
+    explicit PowercapCounters (const HWconfig&);
+    PowercapCounters (const PowercapCounters&) = delete;
+    PowercapCounters& operator= (const PowercapCounters&) = delete;
+    ~PowercapCounters ();
+
+    PowerSample power (const CPUreading&, double) override;
+    std::size_t domains () const { return zones.size(); }
+    double packageJoules () const { return package_j; }
+    double dramJoules () const { return dram_j; }
+
+private:
+    struct Zone {
+        int fd;                                     //energy_uj
+        bool dram;
+        unsigned long long max_range;               //max_energy_range_uj
+        unsigned long long last;
+    };
+
+    TdpModel fallback;
+    std::vector<Zone> zones;
+    double last_t;
+    double package_j;                               //measured since construction, J
+    double dram_j;
+};
+
+std::unique_ptr<EnergySource> makeEnergySource (const HWconfig&);
+bool sameEnergySource (const HWconfig&, const HWconfig&);
+PowerSample pidPower (const PowerSample&, double, double, double, double);
+
+template <typename F, typename Source, typename... Rest>
+void visitEnergySourceAs (EnergySource& source, F& fn) {
+    if (auto* s = dynamic_cast<Source*>(&source)) {
+        fn(*s);
+    } else if constexpr (sizeof...(Rest) != 0) {
+        visitEnergySourceAs<F, Rest...>(source, fn);
+    } else {
+        fn(source);
+    }
+}
+
+/**
+ *  @brief Calls fn with source cast to its concrete type, one of the sources makeEnergySource()
+ *  builds, so that a generic fn is instantiated once per power model and the power() of the
+ *  policies is inlined into it (see EnergyAccumulator::push). Other sources are passed as
+ *  EnergySource&. The cast is done once, the sampling loop is meant to run inside fn.
+*/
+template <typename F>
+void visitEnergySource (EnergySource& source, F&& fn) {
+    visitEnergySourceAs<F, PowercapCounters,
+                        ModelSource<TdpLinear, RamPerGB>, ModelSource<TdpLinear, DramFamily>,
+                        ModelSource<TdpIdleFloor, RamPerGB>, ModelSource<TdpIdleFloor, DramFamily>,
+                        ModelSource<CoreFrequency, RamPerGB>, ModelSource<CoreFrequency, DramFamily>>(source, fn);
+}
+
+/**
+ *  @brief A time series of grid carbon intensity, (UNIX timestamp in s, gCO2/kWh) pairs.
+ *
+ *  The intensity is a step function: each value holds from its timestamp to the next one, the
+ *  first value also before the series and the last one after it. Timestamps and values are kept
+ *  in two sorted arrays, together with the running integral of the intensity at each timestamp,
+ *  so the integral over any interval costs two lookups. Lookups are binary searches, or O(1)
+ *  when the caller keeps a cursor and moves forward in time, as samplers do.
+*/
+class CarbonProfile {
+public:
+    bool load (const std::string&);
+    void assign (std::vector<std::pair<double, double>>);
+
+    std::size_t size () const { return times.size(); }
+    bool empty () const { return times.empty(); }
+    double intensity (double) const;
+    double intensity (double, std::size_t&) const;
+    double integral (double, double, std::size_t&) const;
+
+    void serialize (std::string&) const;
+    bool deserialize (const char*&, const char*);
+
+private:
+    std::size_t find (double, std::size_t&) const;
+    double primitive (double, std::size_t&) const;
+
+    std::vector<double> times;
+    std::vector<double> values;
+    std::vector<double> cumulative;                 //integral of the intensity from times[0] to times[i]
+};
+
+/**
+ *  @brief An online energy and carbon footprint accumulator, updated once per sample.
+ *
+ *  The absorbed power is modelled as in carbonFootprint(): n_cpu * cpu_tdp * cpu_usage for
+ *  the cores plus mem_gb * ram_power_usage for the RAM. Power is integrated over time with the
+ *  trapezoidal rule, CPU usage, allocated memory and power are summarised by RunningStats, so
+ *  memory does not grow with the length of the run and the footprint is available at any time.
+ *  Samples given as CPUreading intervals can take their power from another EnergySource.
+ *  The footprint is accumulated interval by interval: when the HWconfig holds a CarbonProfile,
+ *  the energy of each interval is priced with the intensity in effect over it, and t must then
+ *  be read from upTime(), so that it can be mapped to wall-clock time.
+ *  The HWconfig and the EnergySource are referenced, so they must outlive the accumulator.
+*/
+class EnergyAccumulator {
+public:
+    explicit EnergyAccumulator (const HWconfig&);
+    EnergyAccumulator (const HWconfig&, EnergySource&);
+
+    void push (double, double, double);
+    void push (double, const CPUreading&, double);
+    void push (double, const CPUreading&, double, const PowerSample&);
+    void setSource (EnergySource& s) { source = &s; }   //e.g. rebuilt after a configuration reload
+
+    /**
+     *  @brief push(t, r, mem_gb) with the power taken from source, called on its concrete type:
+     *  with a ModelSource the policies are inlined, without a virtual call per sample.
+    */
+    template <typename Source, typename = decltype(std::declval<Source&>().power(std::declval<const CPUreading&>(), 0.))>
+    void push (double t, const CPUreading& r, double mem_gb, Source& source) { push(t, r, mem_gb, source.power(r, mem_gb)); }
+
+    double joules () const { return energy; }
+    double elapsed () const { return duration; }
+    double lastPower () const { return last_cpu_power + last_mem_power; }
+    PowerSample lastSample () const { return {last_cpu_power, last_mem_power}; }
+    double footprint () const;
+    const RunningStats& cpu () const { return cpu_stats; }
+    const RunningStats& mem () const { return mem_stats; }
+    const RunningStats& power () const { return power_stats; }
+
+private:
+    void addEnergy (double, double, double);
+
+    const HWconfig* hw;
+    TdpModel tdp;
+    EnergySource* source;                           //nullptr: tdp
+    RunningStats cpu_stats;
+    RunningStats mem_stats;
+    RunningStats power_stats;
+    double energy;                                  //J
+    double grams;                                   //gCO2e
+    double epoch_offset;                            //UNIX time - upTime()
+    std::size_t cursor;                             //into the CarbonProfile
+    double duration;                                //s
+    double last_t;
+    double last_cpu_power;
+    double last_mem_power;
+};
+
+/**
+ *  @brief A drift-free periodic scheduler for the sampling loop.
+ *
+ *  Deadlines are absolute (start + k * period on CLOCK_MONOTONIC) and reached with
+ *  clock_nanosleep(TIMER_ABSTIME), so the time spent sampling does not shift the period, which
+ *  can go down to the millisecond. When sampling overruns one or more deadlines, they are
+ *  counted as missed and skipped instead of being replayed in a burst. The lateness of every
+ *  wake-up (jitter) is summarised in a RunningStats, in seconds.
+*/
+class Scheduler {
+public:
+    explicit Scheduler (double);
+
+    void wait ();
+    void setPeriod (double);
+    std::size_t ticks () const { return n_ticks; }
+    std::size_t missed () const { return n_missed; }
+    const RunningStats& jitter () const { return lateness; }
+
+private:
+    long long period;                               //ns
+    long long next;                                 //ns, absolute CLOCK_MONOTONIC deadline
+    std::size_t n_ticks;
+    std::size_t n_missed;
+    RunningStats lateness;
+};
+
+/**
+ *  @brief A single-writer sequence lock publishing a trivially copyable value.
+ *
+ *  The writer never waits, readers never block the writer: load() retries while a store() is
+ *  in progress. The value is kept as relaxed atomic words, so concurrent reads are well defined.
+*/
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+    static constexpr std::size_t n_words = (sizeof(T) + sizeof(std::uint64_t) - 1)/sizeof(std::uint64_t);
+
+public:
+    SeqLock () : seq(0) {
+        for (auto& w : words) {
+            w.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void store (const T& value) {
+        std::uint64_t buf[n_words] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        unsigned s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < n_words; i++) {
+            words[i].store(buf[i], std::memory_order_relaxed);
+        }
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    T load () const {
+        std::uint64_t buf[n_words];
+        unsigned before, after;
+        do {
+            before = seq.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < n_words; i++) {
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        T value;
+        std::memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+
+private:
+    std::atomic<unsigned> seq;
+    std::atomic<std::uint64_t> words[n_words];
+};
+
+/**
+ *  @brief The latest readings of a Monitor, as returned by Monitor::snapshot().
+*/
+struct MonitorSnapshot {
+
+    double up_time;                                 /**< Time of the sample, from upTime()           */
+    double cpu_usage;                               /**< CPU usage factor over the last interval     */
+    double cpu_lifetime;                            /**< CPU usage factor since the process started  */
+    double mem_gb;                                  /**< Allocated RAM (VmSize), in GB               */
+    double power;                                   /**< Average power over the last interval, in W  */
+    double joules;                                  /**< Energy accumulated so far                   */
+    double elapsed;                                 /**< Time covered by the accumulated energy, s   */
+    double footprint;                               /**< Carbon footprint so far, in gCO2e           */
+    std::size_t samples;                            /**< Number of samples taken                     */
+
+};
+
+/**
+ *  @brief Keeps an HWconfig in sync with its TOML file, reloading it whenever the file changes.
+ *
+ *  A background thread waits on inotify for the file to be rewritten or replaced, parses it into
+ *  a new HWconfig and, if it is valid, publishes it. generation() is a lock-free atomic load,
+ *  so the sampling thread checks for a reload without waiting; current() is std::atomic_load of
+ *  a shared_ptr, which libstdc++ implements with a pool of mutexes, held for the copy of the
+ *  pointer only, and is meant to be called when generation() has changed. A replaced snapshot is
+ *  released with the last shared_ptr to it, so a monitor whose file is edited many times does
+ *  not grow.
+ *  When built with cache set, the file is loaded as pullConfig() does with its binary cache.
+*/
+class ConfigWatcher {
+public:
+    explicit ConfigWatcher (const std::string&, bool = false);
+    ConfigWatcher (const ConfigWatcher&) = delete;
+    ConfigWatcher& operator= (const ConfigWatcher&) = delete;
+    ~ConfigWatcher ();
+
+    std::shared_ptr<const HWconfig> current () const { return std::atomic_load_explicit(&config, std::memory_order_acquire); }
+    std::size_t generation () const { return n_reloads.load(std::memory_order_acquire); }
+    std::size_t rejected () const { return n_rejected.load(std::memory_order_relaxed); }
+    bool reload ();
+
+private:
+    void run ();
+
+    std::string path;
+    bool cache;                                                 //pullConfig() through the binary cache
+    std::shared_ptr<const HWconfig> config;                     //only accessed with std::atomic_load/atomic_store
+    std::atomic<std::size_t> n_reloads;
+    std::atomic<std::size_t> n_rejected;
+    std::mutex reload_mtx;
+    int inotify_fd;
+    int stop_fd;
+    std::thread worker;
+};
+
+/**
+ *  @brief An in-process monitor sampling a process (by default the calling one, i.e. self
+ *  monitoring) on a dedicated low-priority thread.
+ *
+ *  start() spawns the sampling thread, which runs at nice 19 with the period sampling_period_ms
+ *  (1 s when not set) and the EnergySource selected in the HWconfig. Readings are published
+ *  through a SeqLock, so snapshot() never blocks the sampling thread nor the caller. stop()
+ *  takes a last sample, joins the thread and returns the final footprint in gCO2e.
+ *  The HWconfig is copied.
+*/
+class Monitor {
+public:
+    explicit Monitor (const HWconfig&);
+    Monitor (const HWconfig&, pid_t);
+    Monitor (const ConfigWatcher&, pid_t);
+    Monitor (const Monitor&) = delete;
+    Monitor& operator= (const Monitor&) = delete;
+    ~Monitor ();
+
+    void start ();
+    double stop ();
+    bool running () const { return worker.joinable(); }
+    MonitorSnapshot snapshot () const { return latest.load(); }
+
+private:
+    void run ();
+    template <typename Source>
+    void sample (ProcHandle&, CPUsage&, EnergyAccumulator&, Source&);
+
+    HWconfig hw;
+    const ConfigWatcher* watcher;
+    pid_t proc_id;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable wake;
+    bool stopping;
+    double final_footprint;
+    SeqLock<MonitorSnapshot> latest;
+};
+
+#define SAMPLE_LOG_MAGIC "KIGLOG02"
+#define SAMPLE_LOG_BLOCK 4096                                   //samples per block
+
+/**
+ *  @brief A view over one block of a sample log: one array per column, n entries each.
+*/
+struct SampleBlock {
+
+    std::size_t n;                                  /**< Number of samples in the block              */
+    const double* timestamp;                        /**< Time of the sample, in seconds              */
+    const std::uint64_t* utime;                     /**< utime, in clock ticks                       */
+    const std::uint64_t* stime;                     /**< stime, in clock ticks                       */
+    const std::int64_t* rss;                        /**< Resident set size, in pages                 */
+    const double* power;                            /**< Estimated absorbed power, in W              */
+    const std::int32_t* pid;                        /**< PID of the sampled process                  */
+
+};
+
+/**
+ *  @brief A writer of the binary, columnar log of every sample.
+ *
+ *  The file starts with the 8 bytes SAMPLE_LOG_MAGIC, followed by 8-byte aligned blocks. A block
+ *  is a header of four 32-bit words, a sync word, the checksum of the columns, the block size n
+ *  and its capacity c, then the columns timestamp, utime, stime, rss, power (c 8-byte values each)
+ *  and pid (c 4-byte values, padded to 8 bytes), of which the first n entries are valid. Samples
+ *  are buffered in memory and a full block is appended with a single write(), so logging costs a
+ *  copy per sample. The last, partial block is written by flush() or by the destructor, with
+ *  c = n. Values are in the byte order of the host.
+*/
+class SampleLog {
+public:
+    explicit SampleLog (const std::string&, std::size_t = SAMPLE_LOG_BLOCK);
+    SampleLog (const SampleLog&) = delete;
+    SampleLog& operator= (const SampleLog&) = delete;
+    ~SampleLog ();
+
+    void push (double, pid_t, unsigned long long, unsigned long long, long, double);
+    void flush ();
+    bool good () const { return fd >= 0; }
+
+private:
+    int fd;
+    std::size_t capacity;
+    std::size_t n;
+    std::vector<unsigned char> block;               //header and columns, written as is
+};
+
+/**
+ *  @brief A reader of the sample logs written by SampleLog, mapped read-only in memory.
+ *
+ *  Blocks are exposed as SampleBlock views into the mapping, without copies. A block torn by an
+ *  interrupted write is skipped, and the blocks appended after it are still read.
+*/
+class SampleLogReader {
+public:
+    explicit SampleLogReader (const std::string&);
+    SampleLogReader (const SampleLogReader&) = delete;
+    SampleLogReader& operator= (const SampleLogReader&) = delete;
+    ~SampleLogReader ();
+
+    bool good () const { return data != nullptr; }
+    std::size_t blocks () const { return offsets.size(); }
+    std::size_t size () const;
+    SampleBlock block (std::size_t) const;
+    double joules () const;
+
+private:
+    const unsigned char* data;
+    std::size_t length;
+    std::vector<std::size_t> offsets;
+};
+
+/**
+ *  @brief The readings of one monitored PID served by a MetricsExporter.
+*/
+struct PidMetrics {
+
+    pid_t pid;                                      /**< The monitored PID, 0 for an unused slot     */
+    double power;                                   /**< Average power over the last interval, in W  */
+    double joules;                                  /**< Energy accumulated so far                   */
+    double footprint;                               /**< Carbon footprint so far, in gCO2e           */
+
+};
+
+/**
+ *  @brief Serves the latest readings of the monitored PIDs in the Prometheus text format, over
+ *  HTTP on a Unix domain socket or on a loopback TCP port.
+ *
+ *  The sampling thread publishes the readings of each PID in a fixed slot, a SeqLock: publish()
+ *  never waits and a scrape never blocks it. Connections are served by one thread running an
+ *  epoll loop on non-blocking sockets, each scrape renders the slots on the spot.
+ *  An address of the form "localhost:<port>" or "127.0.0.1:<port>" listens on TCP, the port
+ *  being a number in 1-65535, any other one is the path of a Unix socket, replaced if it is a
+ *  stale socket and removed on destruction. Any other file at that path is left untouched. On
+ *  an invalid address nothing is served: good() returns false and a warning is logged.
+*/
+class MetricsExporter {
+public:
+    MetricsExporter (const std::string&, std::size_t);
+    MetricsExporter (const MetricsExporter&) = delete;
+    MetricsExporter& operator= (const MetricsExporter&) = delete;
+    ~MetricsExporter ();
+
+    bool good () const { return worker.joinable(); }
+    std::size_t size () const { return n_slots; }
+    void publish (std::size_t slot, const PidMetrics& m) { slots[slot].store(m); }
+    void publish (std::size_t slot, pid_t pid, const EnergyAccumulator& acc) {
+        slots[slot].store(PidMetrics{pid, acc.lastPower(), acc.joules(), acc.footprint()});
+    }
+    std::string render () const;
+    std::size_t scrapes () const { return n_scrapes.load(std::memory_order_relaxed); }
+
+private:
+    struct Connection {
+        std::string in;
+        std::string out;
+        std::size_t sent;
+    };
+
+    void run ();
+    bool serve (int, Connection&);
+
+    std::string address;
+    std::string unix_path;                          //empty on TCP
+    std::unique_ptr<SeqLock<PidMetrics>[]> slots;
+    std::size_t n_slots;
+    std::atomic<std::size_t> n_scrapes;
+    int listen_fd;
+    int epoll_fd;
+    int stop_fd;
+    std::thread worker;
+};
+
+/**
+ *  @brief Severity of a LogRecord. A sink set with setLogSink() receives the records at or
+ *  above its level; "off" silences everything.
+*/
+enum class LogLevel : int { debug, info, warning, error, off };
+
+/**
+ *  @brief A structured log record: a key with either a numeric value (text is nullptr) or a
+ *  message. key and text only live for the duration of the call to the sink.
+*/
+struct LogRecord {
+
+    LogLevel level;                                 /**< Severity of the record                      */
+    const char* key;                                /**< What the record is about, e.g. "OCCUPIED"   */
+    double value;                                   /**< The value, for numeric records              */
+    const char* text;                               /**< The message, nullptr for numeric records    */
+
+};
+
+using LogSink = std::function<void (const LogRecord&)>;
+
+void pullConfig (HWconfig&, std::string, bool = false);
+std::vector<std::string> decodeConfig (HWconfig&, const ConfigValue&);
+bool loadConfigCache (HWconfig&, const std::string&);
+bool saveConfigCache (const HWconfig&, const std::string&);
+bool validConfig (const HWconfig&, std::string&);
 double fetchMem (std::string);
+bool parseStatus (MemStatus&, const char*, std::size_t);
+MemStatus fetchStatus (std::string);
 void fillBuffer(std::vector<std::string>&, std::string);
+bool parseStat (CPUsage&, const char*, std::size_t);
+bool readStat (CPUsage&, const std::string&);
 void update (CPUsage&, std::vector<std::string>&, struct sysinfo);
 void flushBuffer(std::vector<std::string>&);//void flushBuffer(CPUsage&);
+double upTime ();
 double CPUusage(CPUsage&, HWconfig&);
+CPUreading CPUusageDelta (CPUsage&, const HWconfig&);
 double carbonFootprint(std::vector<double>&, std::vector<double>&, HWconfig&, double);
-void makeReport(HWconfig&, double, double);
+void makeReport(HWconfig&, double, double, const std::string& = "report.records", const std::string& = "report.txt");
+std::size_t renderReport(const std::string& = "report.records", const std::string& = "report.txt");
+void setLogSink (LogSink, LogLevel);
+LogSink streamLogSink (std::ostream&);
+std::vector<std::vector<int>> numaCpus (const std::string& = "/sys/devices/system/node/");
+bool logEnabled (LogLevel);
+void logValue (LogLevel, const char*, double);
+void logMessage (LogLevel, const char*, const std::string&);
 std::ostream& operator<< (std::ostream& of, std::vector<double>);
 
@@ -0,0 +1,14 @@
+#include "kig_test.h"
+
+int failures = 0;
+
+int main () {
+    testPowercap();
+    testParseStat();
+    testParseStatus();
+    testCarbonProfile();
+    if (failures == 0) {
+        std::cout << "kig_test: all checks passed" << '\n';
+    }
+    return failures;
+}
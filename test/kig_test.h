@@ -0,0 +1,42 @@
+/**
+ * @file
+*/
+
+#ifndef KIG_TEST_H
+#define KIG_TEST_H
+
+#include <KIG.h>
+
+/*-------------------------------------------------------------
+ *
+ *  The checks of kig_test: each test file adds a function
+ *  called by main(), and every failed check is printed and
+ *  counted. kig_test exits with the number of failed checks.
+ *
+ * ------------------------------------------------------------*/
+
+extern int failures;
+
+#define CHECK(cond) checkTrue((cond), #cond, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b) checkNear((a), (b), #a " == " #b, __FILE__, __LINE__)
+
+inline void checkTrue (bool ok, const char* what, const char* file, int line) {
+    if (!ok) {
+        std::cerr << file << ":" << line << ": " << what << " failed" << '\n';
+        failures++;
+    }
+}
+
+inline void checkNear (double a, double b, const char* what, const char* file, int line) {
+    if (!(std::fabs(a - b) < 1e-9)) {
+        std::cerr << file << ":" << line << ": " << what << " failed (" << a << " != " << b << ")" << '\n';
+        failures++;
+    }
+}
+
+void testPowercap ();
+void testParseStat ();
+void testParseStatus ();
+void testCarbonProfile ();
+
+#endif
@@ -0,0 +1,67 @@
+#include "kig_test.h"
+
+/*-------------------------------------------------------------
+ *
+ *  PowercapCounters against a fake powercap folder: two
+ *  packages (one of which wraps around max_energy_range_uj),
+ *  a dram zone and a core zone that must not be counted, and
+ *  a package without max_energy_range_uj, which is skipped.
+ *
+ * ------------------------------------------------------------*/
+
+static void zone (const std::string& root, const std::string& folder, const std::string& name,
+                  unsigned long long energy_uj, unsigned long long max_uj) {
+    std::filesystem::create_directories(root + folder);
+    std::ofstream(root + folder + "/name") << name << '\n';
+    std::ofstream(root + folder + "/max_energy_range_uj") << max_uj << '\n';
+    std::ofstream(root + folder + "/energy_uj") << energy_uj << '\n';
+}
+
+//rewritten in place, as the kernel does: the counters keep their open descriptor
+static void step (const std::string& root, const std::string& folder, unsigned long long energy_uj) {
+    std::ofstream(root + folder + "/energy_uj") << energy_uj << '\n';
+}
+
+void testPowercap () {
+    HWconfig hw;
+    hw.n_cpu = 2;
+    hw.cpu_tdp = 10;
+    hw.ram_power_usage = 0.375;
+    hw.powercap_root = (std::filesystem::temp_directory_path() / ("kig_test_powercap_" + std::to_string(getpid()) + "/")).string();
+
+    zone(hw.powercap_root, "intel-rapl:0", "package-0", 900000, 1000000);
+    zone(hw.powercap_root, "intel-rapl:0:0", "core", 0, 1000000);
+    zone(hw.powercap_root, "intel-rapl:0:2", "dram", 5000, 262143328850ULL);
+    zone(hw.powercap_root, "intel-rapl:1", "package-1", 0, 262143328850ULL);
+    zone(hw.powercap_root, "intel-rapl:2", "package-2", 800000, 1000000);
+    std::filesystem::remove(hw.powercap_root + "intel-rapl:2/max_energy_range_uj");
+
+    {
+        PowercapCounters counters(hw);
+        CHECK_NEAR(counters.domains(), 3.);
+
+        CPUreading r{0.5, 0.5, 1.};
+        PowerSample first = counters.power(r, 2.);          //no interval yet: the TDP model
+        CHECK_NEAR(first.cpu, 2*10*0.5);
+        CHECK_NEAR(counters.packageJoules(), 0.);
+
+        step(hw.powercap_root, "intel-rapl:0", 100000);      //wrapped: 100000 + (1000000 - 900000) uJ
+        step(hw.powercap_root, "intel-rapl:0:0", 999999);
+        step(hw.powercap_root, "intel-rapl:0:2", 255000);
+        step(hw.powercap_root, "intel-rapl:1", 300000);
+        step(hw.powercap_root, "intel-rapl:2", 100000);     //decreased, with no range to wrap around
+        usleep(1000);
+        PowerSample p = counters.power(r, 2.);
+        CHECK_NEAR(counters.packageJoules(), 0.2 + 0.3);
+        CHECK_NEAR(counters.dramJoules(), 0.25);
+        CHECK_NEAR(p.cpu/p.mem, 0.5/0.25);
+
+        step(hw.powercap_root, "intel-rapl:0", 100000);      //unchanged counters add nothing
+        step(hw.powercap_root, "intel-rapl:0:2", 255000);
+        counters.power(r, 2.);
+        CHECK_NEAR(counters.packageJoules(), 0.5);
+        CHECK_NEAR(counters.dramJoules(), 0.25);
+    }
+
+    std::filesystem::remove_all(hw.powercap_root);
+}
@@ -0,0 +1,48 @@
+#include "kig_test.h"
+
+/*-------------------------------------------------------------
+ *
+ *  parseStat and parseStatus on raw /proc buffers: a comm
+ *  with spaces and parentheses, truncated files, and status
+ *  entries in another order or missing.
+ *
+ * ------------------------------------------------------------*/
+
+static const std::string odd_stat =
+    "4242 (my (odd) job) S 1 4242 4242 0 -1 4194560 1520 0 0 0 "
+    "1234 567 0 0 20 0 8 0 98765 123456789 2048 18446744073709551615 "
+    "1 1 0 0 0 0 0 0 0 0 0 0 17 3 0 0 0 0 0\n";
+
+void testParseStat () {
+    CPUsage c{};
+    CHECK(parseStat(c, odd_stat.data(), odd_stat.size()));
+    CHECK(c.utime == 1234);
+    CHECK(c.stime == 567);
+    CHECK(c.num_threads == 8);
+    CHECK(c.starttime == 98765);
+    CHECK(c.rss == 2048);
+
+    //cut inside the comm: no closing ')'
+    CPUsage t{};
+    CHECK(!parseStat(t, odd_stat.data(), 12));
+}
+
+void testParseStatus () {
+    //a kernel printing the entries in another order, without VmSize
+    const std::string reordered =
+        "Name:\tjob\nThreads:\t4\nVmRSS:\t    2048 kB\nVmSwap:\t      16 kB\nVmHWM:\t    4096 kB\n";
+    MemStatus m{};
+    CHECK(parseStatus(m, reordered.data(), reordered.size()));
+    CHECK(m.threads == 4);
+    CHECK(m.vm_rss == 2048);
+    CHECK(m.vm_hwm == 4096);
+    CHECK(m.vm_swap == 16);
+    CHECK(m.vm_size == 0);
+
+    //VmSize and VmRSS are read wherever they appear; a status without Threads is rejected
+    const std::string no_threads = "VmRSS:\t     512 kB\nName:\tjob\nVmSize:\t   10000 kB\n";
+    MemStatus k{};
+    CHECK(!parseStatus(k, no_threads.data(), no_threads.size()));
+    CHECK(k.vm_size == 10000);
+    CHECK(k.vm_rss == 512);
+}
@@ -0,0 +1,37 @@
+#include "kig_test.h"
+
+/*-------------------------------------------------------------
+ *
+ *  CarbonProfile::load on CSV rows with an empty value,
+ *  which must not take their value from the next row, and
+ *  on a .toml profile that does not parse.
+ *
+ * ------------------------------------------------------------*/
+
+void testCarbonProfile () {
+    const auto dir = std::filesystem::temp_directory_path() / ("kig_test_profile_" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+    const std::string csv = (dir / "intensity.csv").string();
+    const std::string toml = (dir / "intensity.toml").string();
+
+    std::ofstream(csv) << "timestamp,gCO2/kWh\n0,100\n3600,\n7200, \n10800,300\n14400,";
+    CarbonProfile p;
+    CHECK(p.load(csv));
+    CHECK(p.size() == 2);
+    CHECK_NEAR(p.intensity(3600), 100);
+    CHECK_NEAR(p.intensity(7200), 100);
+    CHECK_NEAR(p.intensity(10800), 300);
+
+    std::ofstream(toml) << "carbon_intensity = [[0, 100], [3600,\n";
+    CarbonProfile broken;
+    CHECK(!broken.load(toml));
+
+    std::ofstream(toml) << "carbon_intensity = \"flat\"\n";
+    CHECK(!broken.load(toml));
+
+    std::ofstream(toml) << "carbon_intensity = [[0.0, 100.0], [3600.0, 200.0]]\n";
+    CHECK(broken.load(toml));
+    CHECK(broken.size() == 2);
+
+    std::filesystem::remove_all(dir);
+}
@@ -30,6 +30,7 @@
 #define TOML11_VERSION_PATCH 1
 
 #include "toml/parser.hpp"
+#include "toml/arena.hpp"
 #include "toml/literal.hpp"
 #include "toml/serializer.hpp"
 #include "toml/get.hpp"
@@ -0,0 +1,242 @@
+// Distributed under the MIT License.
+#ifndef TOML11_ARENA_HPP
+#define TOML11_ARENA_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace toml
+{
+
+// monotonic_arena hands out memory from a few large blocks, which are all
+// released together when the arena is destroyed. Freed memory is reused by
+// size class, and buffers above max_classed bypass the blocks, so the
+// buffers a growing std::vector leaves behind do not pile up. It is not
+// thread safe.
+class monotonic_arena
+{
+  public:
+
+    explicit monotonic_arena(std::size_t first_block = 64 * 1024)
+      : current_(nullptr), left_(0), next_block_(first_block)
+    {}
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t align)
+    {
+        if(bytes > max_classed && align <= granule)
+        {
+            return ::operator new(bytes);
+        }
+        if(bytes != 0 && align <= granule)
+        {
+            void*& head = free_[size_class(bytes)];
+            align = granule;
+            if(head != nullptr)
+            {
+                void* p = head;
+                head = *static_cast<void**>(p);
+                return p;
+            }
+        }
+        std::size_t pad = padding(align);
+        if(current_ == nullptr || pad + bytes > left_)
+        {
+            // blocks grow geometrically, so a large tree takes a handful of them.
+            const std::size_t size = std::max(next_block_, bytes + align);
+            blocks_.emplace_back(new char[size]);
+            current_    = blocks_.back().get();
+            left_       = size;
+            next_block_ = size * 2;
+            pad = padding(align);
+        }
+        char* p   = current_ + pad;
+        current_ += pad + bytes;
+        left_    -= pad + bytes;
+        return p;
+    }
+
+    // freed memory is kept for reuse by later allocations of the same size
+    // class, e.g. the buffers a growing std::vector leaves behind, and buffers
+    // above max_classed go back to the heap. Over-aligned memory is only
+    // released with the arena.
+    void deallocate(void* p, std::size_t bytes, std::size_t align) noexcept
+    {
+        if(bytes > max_classed && align <= granule)
+        {
+            ::operator delete(p);
+        }
+        else if(bytes != 0 && align <= granule)
+        {
+            void*& head = free_[size_class(bytes)];
+            *static_cast<void**>(p) = head;
+            head = p;
+        }
+    }
+
+    std::size_t blocks() const noexcept {return blocks_.size();}
+
+  private:
+
+    static constexpr std::size_t granule     = alignof(std::max_align_t);
+    static constexpr std::size_t max_pooled  = 32 * granule;
+    static constexpr std::size_t max_classed = 64 * 1024;
+    // one class per granule up to max_pooled, then four per octave, so that
+    // a block is at most 25% larger than the request.
+    static constexpr std::size_t n_classes   = max_pooled / granule + 4 * 7;
+
+    // the index of the free list of `bytes`, which is rounded up to its class.
+    static std::size_t size_class(std::size_t& bytes) noexcept
+    {
+        if(bytes <= max_pooled)
+        {
+            bytes = (bytes + granule - 1) / granule * granule;
+            return bytes / granule - 1;
+        }
+        std::size_t octave = max_pooled;
+        std::size_t index  = max_pooled / granule;
+        while(octave * 2 < bytes)
+        {
+            octave *= 2;
+            index  += 4;
+        }
+        const std::size_t step = octave / 4;
+        const std::size_t m    = (bytes - octave + step - 1) / step;
+        bytes = octave + m * step;
+        return index + m - 1;
+    }
+    std::size_t padding(std::size_t align) const noexcept
+    {
+        return (align - reinterpret_cast<std::uintptr_t>(current_) % align) % align;
+    }
+
+  private:
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    void*       free_[n_classes] = {};
+    char*       current_;
+    std::size_t left_;
+    std::size_t next_block_;
+};
+
+namespace detail
+{
+inline std::shared_ptr<monotonic_arena>& current_arena() noexcept
+{
+    static thread_local std::shared_ptr<monotonic_arena> arena;
+    return arena;
+}
+} // detail
+
+// arena_scope makes the arena_map and arena_vector (see below) containers that are
+// created by this thread allocate from `arena` until it goes out of scope.
+//
+// ```cpp
+// toml::arena_scope scope;
+// const auto data = toml::parse<toml::discard_comments,
+//                               toml::arena_map, toml::arena_vector>("a.toml");
+// ```
+//
+// The values share the ownership of the arena, so it is released with the
+// last value created in it, even after the scope ends.
+class arena_scope
+{
+  public:
+
+    explicit arena_scope(std::shared_ptr<monotonic_arena> arena =
+                             std::make_shared<monotonic_arena>())
+      : previous_(std::move(detail::current_arena()))
+    {
+        detail::current_arena() = std::move(arena);
+    }
+    ~arena_scope()
+    {
+        detail::current_arena() = std::move(previous_);
+    }
+    arena_scope(const arena_scope&) = delete;
+    arena_scope& operator=(const arena_scope&) = delete;
+
+    monotonic_arena& arena() const noexcept {return *detail::current_arena();}
+
+  private:
+
+    std::shared_ptr<monotonic_arena> previous_;
+};
+
+// arena_allocator allocates from the arena of the current arena_scope, or from
+// the heap outside of any scope. Copying a container allocates the copy in the
+// arena of the scope it is copied in, not in the arena of the original.
+template<typename T>
+class arena_allocator
+{
+  public:
+
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    arena_allocator() noexcept : arena_(detail::current_arena()) {}
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) noexcept
+      : arena_(other.arena_)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        if(arena_)
+        {
+            return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if(arena_)
+        {
+            arena_->deallocate(p, n * sizeof(T), alignof(T));
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    arena_allocator select_on_container_copy_construction() const noexcept
+    {
+        return arena_allocator();
+    }
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>& other) const noexcept
+    {
+        return arena_ == other.arena_;
+    }
+    template<typename U>
+    bool operator!=(const arena_allocator<U>& other) const noexcept
+    {
+        return arena_ != other.arena_;
+    }
+
+  private:
+
+    template<typename U> friend class arena_allocator;
+
+    std::shared_ptr<monotonic_arena> arena_;
+};
+
+// Table and Array of basic_value that allocate from the current arena_scope.
+template<typename Key, typename Value>
+using arena_map = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                     arena_allocator<std::pair<const Key, Value>>>;
+template<typename Value>
+using arena_vector = std::vector<Value, arena_allocator<Value>>;
+
+} // toml
+#endif// TOML11_ARENA_HPP
@@ -480,5 +480,25 @@ operator<<(std::basic_ostream<charT, traits>& os, const discard_comments&)
     return os;
 }
 
+// `compact_regions` discards comments just like `discard_comments`, and it also
+// makes the parser keep the location of each value in a compact form.
+//
+// const toml::basic_value<toml::compact_regions> data =
+//     toml::parse<toml::compact_regions>("large.toml");
+//
+// Normally each parsed value allocates its own region, which holds a shared_ptr
+// to the file content and a copy of the file name. With this, the values share
+// one array of 32-bit offsets and lengths owned by the file content, so a value
+// costs no allocation. Each value still holds an aliasing shared_ptr to its
+// entry, so copying a value increments the reference count of the content.
+// Error messages are the same, only slower to generate.
+struct compact_regions : public discard_comments
+{
+    using discard_comments::discard_comments;
+
+    compact_regions() = default;
+    explicit compact_regions(const discard_comments&) noexcept {}
+};
+
 } // toml11
 #endif// TOML11_COMMENTS_HPP
@@ -6,6 +6,12 @@
 #include <fstream>
 #include <sstream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "combinator.hpp"
 #include "lexer.hpp"
 #include "region.hpp"
@@ -1135,7 +1141,7 @@ parse_array(location& loc)
         if(loc.iter() != loc.end() && *loc.iter() == ']')
         {
             loc.advance(); // skip ']'
-            return ok(std::make_pair(retval,
+            return ok(std::make_pair(std::move(retval),
                       region(loc, first, loc.iter())));
         }
 
@@ -1188,7 +1194,7 @@ parse_array(location& loc)
             if(loc.iter() != loc.end() && *loc.iter() == ']')
             {
                 loc.advance(); // skip ']'
-                return ok(std::make_pair(retval,
+                return ok(std::make_pair(std::move(retval),
                           region(loc, first, loc.iter())));
             }
             else
@@ -1456,7 +1462,7 @@ bool is_valid_forward_table_definition(const Value& fwd, const Value& inserting,
 
 template<typename Value, typename InputIterator>
 result<bool, std::string>
-insert_nested_key(typename Value::table_type& root, const Value& v,
+insert_nested_key(typename Value::table_type& root, Value v,
                   InputIterator iter, const InputIterator last,
                   region key_reg,
                   const bool is_array_of_table = false)
@@ -1557,7 +1563,7 @@ insert_nested_key(typename Value::table_type& root, const Value& v,
                                 }), v.location());
                         }
                     }
-                    a.push_back(v);
+                    a.push_back(std::move(v));
                     return ok(true);
                 }
                 else // if not, we need to create the array of table
@@ -1596,8 +1602,10 @@ insert_nested_key(typename Value::table_type& root, const Value& v,
                     {
                         comments = key_reg.comments();
                     }
-                    value_type aot(array_type(1, v), key_reg, std::move(comments));
-                    tab->insert(std::make_pair(k, aot));
+                    array_type tables;
+                    tables.push_back(std::move(v));
+                    value_type aot(std::move(tables), key_reg, std::move(comments));
+                    tab->insert(std::make_pair(k, std::move(aot)));
                     return ok(true);
                 }
             } // end if(array of table)
@@ -1662,7 +1670,7 @@ insert_nested_key(typename Value::table_type& root, const Value& v,
                         }), v.location());
                 }
             }
-            tab->insert(std::make_pair(k, v));
+            tab->insert(std::make_pair(k, std::move(v)));
             return ok(true);
         }
         else // k is not the last one, we should insert recursively
@@ -1778,25 +1786,25 @@ parse_inline_table(location& loc)
     if(loc.iter() != loc.end() && *loc.iter() == '}')
     {
         loc.advance(); // skip `}`
-        return ok(std::make_pair(retval, region(loc, first, loc.iter())));
+        return ok(std::make_pair(std::move(retval), region(loc, first, loc.iter())));
     }
 
     // it starts from "{". it should be formatted as inline-table
     while(loc.iter() != loc.end())
     {
-        const auto kv_r = parse_key_value_pair<value_type>(loc);
+        auto kv_r = parse_key_value_pair<value_type>(loc);
         if(!kv_r)
         {
             return err(kv_r.unwrap_err());
         }
 
-        const auto&              kvpair  = kv_r.unwrap();
+        auto&                    kvpair  = kv_r.unwrap();
         const std::vector<key>&  keys    = kvpair.first.first;
         const auto&              key_reg = kvpair.first.second;
-        const value_type&        val     = kvpair.second;
+        value_type&              val     = kvpair.second;
 
-        const auto inserted =
-            insert_nested_key(retval, val, keys.begin(), keys.end(), key_reg);
+        const auto inserted = insert_nested_key(
+                retval, std::move(val), keys.begin(), keys.end(), key_reg);
         if(!inserted)
         {
             throw internal_error("toml::parse_inline_table: "
@@ -1822,7 +1830,7 @@ parse_inline_table(location& loc)
             {
                 loc.advance(); // skip `}`
                 return ok(std::make_pair(
-                            retval, region(loc, first, loc.iter())));
+                            std::move(retval), region(loc, first, loc.iter())));
             }
             else if(*loc.iter() == '#' || *loc.iter() == '\r' || *loc.iter() == '\n')
             {
@@ -2211,22 +2219,22 @@ parse_ml_table(location& loc)
         if(const auto tmp = parse_array_table_key(loc)) // next table found
         {
             loc.reset(before);
-            return ok(tab);
+            return ok(std::move(tab));
         }
         if(const auto tmp = parse_table_key(loc)) // next table found
         {
             loc.reset(before);
-            return ok(tab);
+            return ok(std::move(tab));
         }
 
-        if(const auto kv = parse_key_value_pair<value_type>(loc))
+        if(auto kv = parse_key_value_pair<value_type>(loc))
         {
-            const auto&              kvpair  = kv.unwrap();
+            auto&                    kvpair  = kv.unwrap();
             const std::vector<key>&  keys    = kvpair.first.first;
             const auto&              key_reg = kvpair.first.second;
-            const value_type&        val     = kvpair.second;
-            const auto inserted =
-                insert_nested_key(tab, val, keys.begin(), keys.end(), key_reg);
+            value_type&              val     = kvpair.second;
+            const auto inserted = insert_nested_key(
+                    tab, std::move(val), keys.begin(), keys.end(), key_reg);
             if(!inserted)
             {
                 return err(inserted.unwrap_err());
@@ -2266,7 +2274,7 @@ parse_ml_table(location& loc)
         lex_ws::invoke(loc);
         lex_comment::invoke(loc);
     }
-    return ok(tab);
+    return ok(std::move(tab));
 }
 
 template<typename Value>
@@ -2323,7 +2331,7 @@ result<Value, std::string> parse_toml_file(location& loc)
 
     table_type data;
     // root object is also a table, but without [tablename]
-    if(const auto tab = parse_ml_table<value_type>(loc))
+    if(auto tab = parse_ml_table<value_type>(loc))
     {
         data = std::move(tab.unwrap());
     }
@@ -2339,7 +2347,7 @@ result<Value, std::string> parse_toml_file(location& loc)
         // message.
         if(const auto tabkey = parse_array_table_key(loc))
         {
-            const auto tab = parse_ml_table<value_type>(loc);
+            auto tab = parse_ml_table<value_type>(loc);
             if(!tab){return err(tab.unwrap_err());}
 
             const auto& tk   = tabkey.unwrap();
@@ -2347,7 +2355,7 @@ result<Value, std::string> parse_toml_file(location& loc)
             const auto& reg  = tk.second;
 
             const auto inserted = insert_nested_key(data,
-                    value_type(tab.unwrap(), reg, reg.comments()),
+                    value_type(std::move(tab.unwrap()), reg, reg.comments()),
                     keys.begin(), keys.end(), reg,
                     /*is_array_of_table=*/ true);
             if(!inserted) {return err(inserted.unwrap_err());}
@@ -2356,7 +2364,7 @@ result<Value, std::string> parse_toml_file(location& loc)
         }
         if(const auto tabkey = parse_table_key(loc))
         {
-            const auto tab = parse_ml_table<value_type>(loc);
+            auto tab = parse_ml_table<value_type>(loc);
             if(!tab){return err(tab.unwrap_err());}
 
             const auto& tk   = tabkey.unwrap();
@@ -2364,7 +2372,7 @@ result<Value, std::string> parse_toml_file(location& loc)
             const auto& reg  = tk.second;
 
             const auto inserted = insert_nested_key(data,
-                value_type(tab.unwrap(), reg, reg.comments()),
+                value_type(std::move(tab.unwrap()), reg, reg.comments()),
                 keys.begin(), keys.end(), reg);
             if(!inserted) {return err(inserted.unwrap_err());}
 
@@ -2381,23 +2389,10 @@ template<typename                     Comment = TOML11_DEFAULT_COMMENT_STRATEGY,
          template<typename ...> class Table   = std::unordered_map,
          template<typename ...> class Array   = std::vector>
 basic_value<Comment, Table, Array>
-parse(std::vector<char>& letters, const std::string& fname)
+parse_location(location& loc)
 {
     using value_type = basic_value<Comment, Table, Array>;
 
-    // append LF.
-    // Although TOML does not require LF at the EOF, to make parsing logic
-    // simpler, we "normalize" the content by adding LF if it does not exist.
-    // It also checks if the last char is CR, to avoid changing the meaning.
-    // This is not the *best* way to deal with the last character, but is a
-    // simple and quick fix.
-    if(!letters.empty() && letters.back() != '\n' && letters.back() != '\r')
-    {
-        letters.push_back('\n');
-    }
-
-    detail::location loc(std::move(fname), std::move(letters));
-
     // skip BOM if exists.
     // XXX component of BOM (like 0xEF) exceeds the representable range of
     // signed char, so on some (actually, most) of the environment, these cannot
@@ -2424,6 +2419,91 @@ parse(std::vector<char>& letters, const std::string& fname)
     }
 }
 
+template<typename                     Comment = TOML11_DEFAULT_COMMENT_STRATEGY,
+         template<typename ...> class Table   = std::unordered_map,
+         template<typename ...> class Array   = std::vector>
+basic_value<Comment, Table, Array>
+parse(std::vector<char>& letters, const std::string& fname)
+{
+    // append LF.
+    // Although TOML does not require LF at the EOF, to make parsing logic
+    // simpler, we "normalize" the content by adding LF if it does not exist.
+    // It also checks if the last char is CR, to avoid changing the meaning.
+    // This is not the *best* way to deal with the last character, but is a
+    // simple and quick fix.
+    if(!letters.empty() && letters.back() != '\n' && letters.back() != '\r')
+    {
+        letters.push_back('\n');
+    }
+
+    detail::location loc(std::move(fname), std::move(letters));
+    return parse_location<Comment, Table, Array>(loc);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// pread_source reads a file into a buffer of its own with pread(2), in one
+// call when the file does not change meanwhile: the buffer is sized by fstat,
+// with room for the trailing LF (see parse() above), and grown if the file
+// grows. A file truncated or rewritten by another process cannot fault the
+// reader, which sees at worst a torn document that fails to parse.
+struct pread_source final : public source_buffer
+{
+    explicit pread_source(const std::string& fname)
+    {
+        const int fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            throw file_io_error(errno, "Failed to open", fname);
+        }
+        struct stat st;
+        if(::fstat(fd, &st) != 0)
+        {
+            const int err = errno;
+            ::close(fd);
+            throw file_io_error(err, "Failed to access", fname);
+        }
+        buffer_.resize(static_cast<std::size_t>(st.st_size) + 1);
+        std::size_t size = 0;
+        while(true)
+        {
+            if(size == buffer_.size())
+            {
+                buffer_.resize(buffer_.size() * 2);
+            }
+            const ssize_t n = ::pread(fd, buffer_.data() + size,
+                buffer_.size() - size, static_cast<off_t>(size));
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n < 0)
+            {
+                const int err = errno;
+                ::close(fd);
+                throw file_io_error(err, "Failed to read", fname);
+            }
+            if(n == 0)
+            {
+                break;
+            }
+            size += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+        buffer_.resize(size);
+        if(!buffer_.empty() && buffer_.back() != '\n' && buffer_.back() != '\r')
+        {
+            buffer_.push_back('\n');
+        }
+    }
+
+    const char* data() const noexcept override {return buffer_.data();}
+    std::size_t size() const noexcept override {return buffer_.size();}
+
+  private:
+    std::vector<char> buffer_;
+};
+#endif // unix
+
 } // detail
 
 template<typename                     Comment = TOML11_DEFAULT_COMMENT_STRATEGY,
@@ -2501,6 +2581,24 @@ basic_value<Comment, Table, Array> parse(std::string fname)
     return parse<Comment, Table, Array>(ifs, std::move(fname));
 }
 
+#if defined(__unix__) || defined(__APPLE__)
+// `parse(fname, toml::pread_file)` reads the file with pread(2) into a buffer
+// sized once by fstat, without the seeks and the stream of parse(fname). It is
+// safe on files that other processes rewrite or truncate (see pread_source).
+struct pread_file_t {};
+constexpr pread_file_t pread_file{};
+
+template<typename                     Comment = TOML11_DEFAULT_COMMENT_STRATEGY,
+         template<typename ...> class Table   = std::unordered_map,
+         template<typename ...> class Array   = std::vector>
+basic_value<Comment, Table, Array>
+parse(const std::string& fname, pread_file_t)
+{
+    detail::location loc(fname, std::make_shared<detail::pread_source>(fname));
+    return detail::parse_location<Comment, Table, Array>(loc);
+}
+#endif // unix
+
 #ifdef TOML11_HAS_STD_FILESYSTEM
 // This function just forwards `parse("filename.toml")` to std::string version
 // to avoid the ambiguity in overload resolution.
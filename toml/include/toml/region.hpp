@@ -9,6 +9,11 @@
 #include <iterator>
 #include <iomanip>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
 #include "color.hpp"
 
 namespace toml
@@ -62,6 +67,88 @@ struct region_base
     // ```
 };
 
+struct source_buffer;
+struct region;
+
+// compact_region is the region kept by a value parsed with the
+// toml::compact_regions policy: a 32-bit offset and length into the source,
+// which owns it (see source_buffer::intern). Unlike region, it holds neither
+// a shared_ptr nor a copy of the file name; the value refers to it through an
+// aliasing shared_ptr to the source, which costs no allocation but is still
+// reference counted. The members that need more than
+// the text itself expand it into a region first; they are only used for error
+// messages.
+struct compact_region final : public region_base
+{
+    compact_region(const source_buffer* src, std::uint32_t first, std::uint32_t size)
+      : source_(src), first_(first), size_(size)
+    {}
+
+    bool is_ok() const noexcept override {return true;}
+    char front() const noexcept override;
+
+    std::string str()      const override;
+    std::string name()     const override;
+    std::string line()     const override;
+    std::string line_num() const override;
+
+    std::size_t size()   const noexcept override {return size_;}
+    std::size_t before() const noexcept override;
+    std::size_t after()  const noexcept override;
+
+    std::vector<std::string> comments() const override;
+
+  private:
+
+    region expand() const;
+
+  private:
+
+    const source_buffer* source_;
+    std::uint32_t        first_, size_;
+};
+
+// source_buffer is the content of a file that location and region refer to.
+// They only use [cbegin(), cend()), so the content can be owned in a
+// std::vector (vector_source, pread_source in parser.hpp) or anywhere else
+// that outlives the values. The content must end with a newline if it is not
+// empty; see parse() in parser.hpp.
+struct source_buffer : public std::enable_shared_from_this<source_buffer>
+{
+    virtual ~source_buffer() = default;
+
+    virtual const char* data() const noexcept = 0;
+    virtual std::size_t size() const noexcept = 0;
+
+    const char* cbegin() const noexcept {return this->data();}
+    const char* cend()   const noexcept {return this->data() + this->size();}
+
+    // store `reg` as a compact_region in this buffer and return it, sharing
+    // the ownership of this buffer. It returns nullptr if the buffer is too
+    // large for 32-bit offsets or `reg` has another source name, and the
+    // caller should keep `reg` itself then. Only the parser calls it, and a
+    // buffer is parsed by one thread at a time.
+    std::shared_ptr<region_base> intern(const region& reg) const;
+
+    const std::string& name() const noexcept {return name_;}
+
+  private:
+
+    mutable std::deque<compact_region> regions_;
+    mutable std::string                name_;
+};
+
+struct vector_source final : public source_buffer
+{
+    explicit vector_source(std::vector<char> cont): buffer_(std::move(cont)) {}
+
+    const char* data() const noexcept override {return buffer_.data();}
+    std::size_t size() const noexcept override {return buffer_.size();}
+
+  private:
+    std::vector<char> buffer_;
+};
+
 // location represents a position in a container, which contains a file content.
 // it can be considered as a region that contains only one character.
 //
@@ -69,18 +156,23 @@ struct region_base
 // location.
 struct location final : public region_base
 {
-    using const_iterator  = typename std::vector<char>::const_iterator;
-    using difference_type = typename const_iterator::difference_type;
-    using source_ptr      = std::shared_ptr<const std::vector<char>>;
+    using const_iterator  = const char*;
+    using difference_type = std::ptrdiff_t;
+    using source_ptr      = std::shared_ptr<const source_buffer>;
 
     location(std::string source_name, std::vector<char> cont)
-      : source_(std::make_shared<std::vector<char>>(std::move(cont))),
+      : source_(std::make_shared<vector_source>(std::move(cont))),
         line_number_(1), source_name_(std::move(source_name)), iter_(source_->cbegin())
     {}
     location(std::string source_name, const std::string& cont)
-      : source_(std::make_shared<std::vector<char>>(cont.begin(), cont.end())),
+      : source_(std::make_shared<vector_source>(
+                    std::vector<char>(cont.begin(), cont.end()))),
         line_number_(1), source_name_(std::move(source_name)), iter_(source_->cbegin())
     {}
+    location(std::string source_name, source_ptr src)
+      : source_(std::move(src)), line_number_(1),
+        source_name_(std::move(source_name)), iter_(source_->cbegin())
+    {}
 
     location(const location&) = default;
     location(location&&)      = default;
@@ -91,8 +183,8 @@ struct location final : public region_base
     bool is_ok() const noexcept override {return static_cast<bool>(source_);}
     char front() const noexcept override {return *iter_;}
 
-    // this const prohibits codes like `++(loc.iter())`.
-    const const_iterator iter()  const noexcept {return iter_;}
+    // const_iterator is a raw pointer, so `++(loc.iter())` does not compile.
+    const_iterator iter()  const noexcept {return iter_;}
 
     const_iterator begin() const noexcept {return source_->cbegin();}
     const_iterator end()   const noexcept {return source_->cend();}
@@ -196,8 +288,8 @@ struct location final : public region_base
 // and last location.
 struct region final : public region_base
 {
-    using const_iterator = typename std::vector<char>::const_iterator;
-    using source_ptr     = std::shared_ptr<const std::vector<char>>;
+    using const_iterator = const char*;
+    using source_ptr     = std::shared_ptr<const source_buffer>;
 
     // delete default constructor. source_ never be null.
     region() = delete;
@@ -217,6 +309,9 @@ struct region final : public region_base
     region(location&& loc, const_iterator f, const_iterator l)
       : source_(loc.source()), source_name_(loc.name()), first_(f), last_(l)
     {}
+    region(source_ptr src, std::string name, const_iterator f, const_iterator l)
+      : source_(std::move(src)), source_name_(std::move(name)), first_(f), last_(l)
+    {}
 
     region(const region&) = default;
     region(region&&)      = default;
@@ -295,6 +390,7 @@ struct region final : public region_base
     source_ptr&&      source() &&     noexcept {return std::move(source_);}
 
     std::string name() const override {return source_name_;}
+    std::string const& source_name() const noexcept {return source_name_;}
 
     std::vector<std::string> comments() const override
     {
@@ -411,6 +507,69 @@ struct region final : public region_base
     const_iterator first_, last_;
 };
 
+inline std::shared_ptr<region_base> source_buffer::intern(const region& reg) const
+{
+    if(this->size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        return nullptr;
+    }
+    if(regions_.empty())
+    {
+        name_ = reg.source_name();
+    }
+    else if(name_ != reg.source_name())
+    {
+        return nullptr;
+    }
+    regions_.emplace_back(this,
+        static_cast<std::uint32_t>(reg.first() - this->cbegin()),
+        static_cast<std::uint32_t>(reg.size()));
+
+    // aliasing constructor: no allocation, just another owner of the buffer.
+    return std::shared_ptr<region_base>(this->shared_from_this(), &regions_.back());
+}
+
+inline region compact_region::expand() const
+{
+    const auto first = source_->cbegin() + first_;
+    return region(source_->shared_from_this(), source_->name(), first, first + size_);
+}
+
+inline char compact_region::front() const noexcept
+{
+    return source_->cbegin()[first_];
+}
+inline std::string compact_region::str() const
+{
+    const auto first = source_->cbegin() + first_;
+    return make_string(first, first + size_);
+}
+inline std::string compact_region::name() const
+{
+    return source_->name();
+}
+inline std::string compact_region::line()     const {return expand().line();}
+inline std::string compact_region::line_num() const {return expand().line_num();}
+
+inline std::size_t compact_region::before() const noexcept
+{
+    using reverse_iterator = std::reverse_iterator<const char*>;
+    const auto first = source_->cbegin() + first_;
+    const auto line_begin = std::find(reverse_iterator(first),
+            reverse_iterator(source_->cbegin()), '\n').base();
+    return static_cast<std::size_t>(first - line_begin);
+}
+inline std::size_t compact_region::after() const noexcept
+{
+    const auto last = source_->cbegin() + first_ + size_;
+    return static_cast<std::size_t>(std::find(last, source_->cend(), '\n') - last);
+}
+
+inline std::vector<std::string> compact_region::comments() const
+{
+    return expand().comments();
+}
+
 } // detail
 } // toml
 #endif// TOML11_REGION_H
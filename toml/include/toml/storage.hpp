@@ -2,6 +2,8 @@
 // Distributed under the MIT License.
 #ifndef TOML11_STORAGE_HPP
 #define TOML11_STORAGE_HPP
+#include <memory>
+
 #include "utility.hpp"
 
 namespace toml
@@ -9,6 +11,20 @@ namespace toml
 namespace detail
 {
 
+// storage allocates the content through the allocator of the content itself,
+// so that a container allocating from an arena (see arena.hpp) is also placed
+// in the arena. Types without allocator_type use std::allocator.
+struct storage_allocator_impl
+{
+    template<typename T>
+    static typename std::allocator_traits<typename T::allocator_type>::template
+        rebind_alloc<T> check(typename T::allocator_type*);
+    template<typename T>
+    static std::allocator<T> check(...);
+};
+template<typename T>
+using storage_allocator_t = decltype(storage_allocator_impl::check<T>(nullptr));
+
 // this contains pointer and deep-copy the content if copied.
 // to avoid recursive pointer.
 template<typename T>
@@ -16,13 +32,13 @@ struct storage
 {
     using value_type = T;
 
-    explicit storage(value_type const& v): ptr(toml::make_unique<T>(v)) {}
-    explicit storage(value_type&&      v): ptr(toml::make_unique<T>(std::move(v))) {}
+    explicit storage(value_type const& v): ptr(make(v)) {}
+    explicit storage(value_type&&      v): ptr(make(std::move(v))) {}
     ~storage() = default;
-    storage(const storage& rhs): ptr(toml::make_unique<T>(*rhs.ptr)) {}
+    storage(const storage& rhs): ptr(make(*rhs.ptr)) {}
     storage& operator=(const storage& rhs)
     {
-        this->ptr = toml::make_unique<T>(*rhs.ptr);
+        this->ptr = make(*rhs.ptr);
         return *this;
     }
     storage(storage&&) = default;
@@ -35,7 +51,42 @@ struct storage
     value_type&&      value() &&     noexcept {return std::move(*ptr);}
 
   private:
-    std::unique_ptr<value_type> ptr;
+
+    using allocator_type = storage_allocator_t<value_type>;
+    using traits         = std::allocator_traits<allocator_type>;
+
+    // derives from the allocator to keep std::allocator zero-sized.
+    struct deleter : private allocator_type
+    {
+        explicit deleter(const allocator_type& alloc): allocator_type(alloc) {}
+
+        void operator()(value_type* p) noexcept
+        {
+            allocator_type& alloc = *this;
+            traits::destroy(alloc, p);
+            traits::deallocate(alloc, p, 1);
+        }
+    };
+
+    template<typename U>
+    static std::unique_ptr<value_type, deleter> make(U&& v)
+    {
+        allocator_type alloc;
+        value_type* p = traits::allocate(alloc, 1);
+        try
+        {
+            traits::construct(alloc, p, std::forward<U>(v));
+        }
+        catch(...)
+        {
+            traits::deallocate(alloc, p, 1);
+            throw;
+        }
+        return std::unique_ptr<value_type, deleter>(p, deleter(alloc));
+    }
+
+  private:
+    std::unique_ptr<value_type, deleter> ptr;
 };
 
 } // detail
@@ -27,10 +27,33 @@ inline region_base const* get_region(const Value& v)
     return v.region_info_.get();
 }
 
+// values that have no region share this one instead of allocating their own.
+inline std::shared_ptr<region_base> const& empty_region()
+{
+    static const std::shared_ptr<region_base> empty =
+        std::make_shared<region_base>();
+    return empty;
+}
+
+// with toml::compact_regions, a parsed value keeps a compact_region owned by
+// the source buffer instead of a region of its own. see region.hpp.
+template<typename Comment>
+std::shared_ptr<region_base> make_region_info(region reg)
+{
+    if(std::is_same<Comment, ::toml::compact_regions>::value)
+    {
+        if(auto compact = reg.source()->intern(reg))
+        {
+            return compact;
+        }
+    }
+    return std::make_shared<region>(std::move(reg));
+}
+
 template<typename Value>
 void change_region(Value& v, region reg)
 {
-    v.region_info_ = std::make_shared<region>(std::move(reg));
+    v.region_info_ = make_region_info<typename Value::comment_type>(std::move(reg));
     return;
 }
 
@@ -204,7 +227,7 @@ class basic_value
 
     basic_value() noexcept
         : type_(value_t::empty),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {}
     ~basic_value() noexcept {this->cleanup();}
 
@@ -226,7 +249,10 @@ class basic_value
             default: break;
         }
     }
+    // noexcept lets Array<basic_value> move its elements when it grows
+    // instead of deep-copying every nested array and table.
     basic_value(basic_value&& v)
+        noexcept(std::is_nothrow_move_constructible<comment_type>::value)
         : type_(v.type()), region_info_(std::move(v.region_info_)),
           comments_(std::move(v.comments_))
     {
@@ -444,7 +470,7 @@ class basic_value
 
     basic_value(boolean b)
         : type_(value_t::boolean),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->boolean_, b);
     }
@@ -452,13 +478,13 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::boolean;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->boolean_, b);
         return *this;
     }
     basic_value(boolean b, std::vector<std::string> com)
         : type_(value_t::boolean),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->boolean_, b);
@@ -471,7 +497,7 @@ class basic_value
         std::nullptr_t>::type = nullptr>
     basic_value(T i)
         : type_(value_t::integer),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->integer_, static_cast<integer>(i));
     }
@@ -483,7 +509,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::integer;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->integer_, static_cast<integer>(i));
         return *this;
     }
@@ -493,7 +519,7 @@ class basic_value
         std::nullptr_t>::type = nullptr>
     basic_value(T i, std::vector<std::string> com)
         : type_(value_t::integer),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->integer_, static_cast<integer>(i));
@@ -505,7 +531,7 @@ class basic_value
         std::is_floating_point<T>::value, std::nullptr_t>::type = nullptr>
     basic_value(T f)
         : type_(value_t::floating),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->floating_, static_cast<floating>(f));
     }
@@ -517,7 +543,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::floating;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->floating_, static_cast<floating>(f));
         return *this;
     }
@@ -526,7 +552,7 @@ class basic_value
         std::is_floating_point<T>::value, std::nullptr_t>::type = nullptr>
     basic_value(T f, std::vector<std::string> com)
         : type_(value_t::floating),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->floating_, f);
@@ -536,7 +562,7 @@ class basic_value
 
     basic_value(toml::string s)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, std::move(s));
     }
@@ -544,13 +570,13 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::string ;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->string_, s);
         return *this;
     }
     basic_value(toml::string s, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, std::move(s));
@@ -558,7 +584,7 @@ class basic_value
 
     basic_value(std::string s)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(std::move(s)));
     }
@@ -566,26 +592,26 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::string ;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->string_, toml::string(std::move(s)));
         return *this;
     }
     basic_value(std::string s, string_t kind)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(std::move(s), kind));
     }
     basic_value(std::string s, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(std::move(s)));
     }
     basic_value(std::string s, string_t kind, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(std::move(s), kind));
@@ -593,7 +619,7 @@ class basic_value
 
     basic_value(const char* s)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(std::string(s)));
     }
@@ -601,26 +627,26 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::string ;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->string_, toml::string(std::string(s)));
         return *this;
     }
     basic_value(const char* s, string_t kind)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(std::string(s), kind));
     }
     basic_value(const char* s, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(std::string(s)));
     }
     basic_value(const char* s, string_t kind, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(std::string(s), kind));
@@ -629,7 +655,7 @@ class basic_value
 #if defined(TOML11_USING_STRING_VIEW) && TOML11_USING_STRING_VIEW>0
     basic_value(std::string_view s)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(s));
     }
@@ -637,26 +663,26 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::string ;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->string_, toml::string(s));
         return *this;
     }
     basic_value(std::string_view s, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(s));
     }
     basic_value(std::string_view s, string_t kind)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->string_, toml::string(s, kind));
     }
     basic_value(std::string_view s, string_t kind, std::vector<std::string> com)
         : type_(value_t::string),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->string_, toml::string(s, kind));
@@ -667,7 +693,7 @@ class basic_value
 
     basic_value(const local_date& ld)
         : type_(value_t::local_date),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->local_date_, ld);
     }
@@ -675,13 +701,13 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::local_date;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->local_date_, ld);
         return *this;
     }
     basic_value(const local_date& ld, std::vector<std::string> com)
         : type_(value_t::local_date),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->local_date_, ld);
@@ -691,13 +717,13 @@ class basic_value
 
     basic_value(const local_time& lt)
         : type_(value_t::local_time),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->local_time_, lt);
     }
     basic_value(const local_time& lt, std::vector<std::string> com)
         : type_(value_t::local_time),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->local_time_, lt);
@@ -706,7 +732,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::local_time;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->local_time_, lt);
         return *this;
     }
@@ -714,7 +740,7 @@ class basic_value
     template<typename Rep, typename Period>
     basic_value(const std::chrono::duration<Rep, Period>& dur)
         : type_(value_t::local_time),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->local_time_, local_time(dur));
     }
@@ -722,7 +748,7 @@ class basic_value
     basic_value(const std::chrono::duration<Rep, Period>& dur,
                 std::vector<std::string> com)
         : type_(value_t::local_time),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->local_time_, local_time(dur));
@@ -732,7 +758,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::local_time;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->local_time_, local_time(dur));
         return *this;
     }
@@ -741,13 +767,13 @@ class basic_value
 
     basic_value(const local_datetime& ldt)
         : type_(value_t::local_datetime),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->local_datetime_, ldt);
     }
     basic_value(const local_datetime& ldt, std::vector<std::string> com)
         : type_(value_t::local_datetime),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->local_datetime_, ldt);
@@ -756,7 +782,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::local_datetime;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->local_datetime_, ldt);
         return *this;
     }
@@ -765,13 +791,13 @@ class basic_value
 
     basic_value(const offset_datetime& odt)
         : type_(value_t::offset_datetime),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->offset_datetime_, odt);
     }
     basic_value(const offset_datetime& odt, std::vector<std::string> com)
         : type_(value_t::offset_datetime),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->offset_datetime_, odt);
@@ -780,20 +806,20 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::offset_datetime;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->offset_datetime_, odt);
         return *this;
     }
     basic_value(const std::chrono::system_clock::time_point& tp)
         : type_(value_t::offset_datetime),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->offset_datetime_, offset_datetime(tp));
     }
     basic_value(const std::chrono::system_clock::time_point& tp,
                 std::vector<std::string> com)
         : type_(value_t::offset_datetime),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->offset_datetime_, offset_datetime(tp));
@@ -802,7 +828,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::offset_datetime;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->offset_datetime_, offset_datetime(tp));
         return *this;
     }
@@ -811,13 +837,13 @@ class basic_value
 
     basic_value(const array_type& ary)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->array_, ary);
     }
     basic_value(const array_type& ary, std::vector<std::string> com)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->array_, ary);
@@ -826,7 +852,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::array ;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->array_, ary);
         return *this;
     }
@@ -838,7 +864,7 @@ class basic_value
         std::nullptr_t>::type = nullptr>
     basic_value(std::initializer_list<T> list)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         array_type ary(list.begin(), list.end());
         assigner(this->array_, std::move(ary));
@@ -848,7 +874,7 @@ class basic_value
         std::nullptr_t>::type = nullptr>
     basic_value(std::initializer_list<T> list, std::vector<std::string> com)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         array_type ary(list.begin(), list.end());
@@ -861,7 +887,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::array;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
 
         array_type ary(list.begin(), list.end());
         assigner(this->array_, std::move(ary));
@@ -876,7 +902,7 @@ class basic_value
         >::value, std::nullptr_t>::type = nullptr>
     basic_value(const T& list)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         static_assert(std::is_convertible<typename T::value_type, value_type>::value,
             "elements of a container should be convertible to toml::value");
@@ -891,7 +917,7 @@ class basic_value
         >::value, std::nullptr_t>::type = nullptr>
     basic_value(const T& list, std::vector<std::string> com)
         : type_(value_t::array),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         static_assert(std::is_convertible<typename T::value_type, value_type>::value,
@@ -912,7 +938,7 @@ class basic_value
 
         this->cleanup();
         this->type_ = value_t::array;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
 
         array_type ary(list.size());
         std::copy(list.begin(), list.end(), ary.begin());
@@ -924,13 +950,13 @@ class basic_value
 
     basic_value(const table_type& tab)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         assigner(this->table_, tab);
     }
     basic_value(const table_type& tab, std::vector<std::string> com)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         assigner(this->table_, tab);
@@ -939,7 +965,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::table;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
         assigner(this->table_, tab);
         return *this;
     }
@@ -948,7 +974,7 @@ class basic_value
 
     basic_value(std::initializer_list<std::pair<key, basic_value>> list)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         table_type tab;
         for(const auto& elem : list) {tab[elem.first] = elem.second;}
@@ -958,7 +984,7 @@ class basic_value
     basic_value(std::initializer_list<std::pair<key, basic_value>> list,
                 std::vector<std::string> com)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         table_type tab;
@@ -969,7 +995,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::table;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
 
         table_type tab;
         for(const auto& elem : list) {tab[elem.first] = elem.second;}
@@ -985,7 +1011,7 @@ class basic_value
         >::value, std::nullptr_t>::type = nullptr>
     basic_value(const Map& mp)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{}))
+          region_info_(detail::empty_region())
     {
         table_type tab;
         for(const auto& elem : mp) {tab[elem.first] = elem.second;}
@@ -997,7 +1023,7 @@ class basic_value
         >::value, std::nullptr_t>::type = nullptr>
     basic_value(const Map& mp, std::vector<std::string> com)
         : type_(value_t::table),
-          region_info_(std::make_shared<region_base>(region_base{})),
+          region_info_(detail::empty_region()),
           comments_(std::move(com))
     {
         table_type tab;
@@ -1012,7 +1038,7 @@ class basic_value
     {
         this->cleanup();
         this->type_ = value_t::table;
-        this->region_info_ = std::make_shared<region_base>(region_base{});
+        this->region_info_ = detail::empty_region();
 
         table_type tab;
         for(const auto& elem : mp) {tab[elem.first] = elem.second;}
@@ -1062,7 +1088,7 @@ class basic_value
 
     basic_value(boolean b, detail::region reg, std::vector<std::string> cm)
         : type_(value_t::boolean),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->boolean_, b);
@@ -1073,7 +1099,7 @@ class basic_value
         >::value, std::nullptr_t>::type = nullptr>
     basic_value(T i, detail::region reg, std::vector<std::string> cm)
         : type_(value_t::integer),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->integer_, static_cast<integer>(i));
@@ -1082,7 +1108,7 @@ class basic_value
         std::is_floating_point<T>::value, std::nullptr_t>::type = nullptr>
     basic_value(T f, detail::region reg, std::vector<std::string> cm)
         : type_(value_t::floating),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->floating_, static_cast<floating>(f));
@@ -1090,7 +1116,7 @@ class basic_value
     basic_value(toml::string s, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::string),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->string_, std::move(s));
@@ -1098,7 +1124,7 @@ class basic_value
     basic_value(const local_date& ld, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::local_date),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->local_date_, ld);
@@ -1106,7 +1132,7 @@ class basic_value
     basic_value(const local_time& lt, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::local_time),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->local_time_, lt);
@@ -1114,7 +1140,7 @@ class basic_value
     basic_value(const local_datetime& ldt, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::local_datetime),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->local_datetime_, ldt);
@@ -1122,7 +1148,7 @@ class basic_value
     basic_value(const offset_datetime& odt, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::offset_datetime),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->offset_datetime_, odt);
@@ -1130,7 +1156,7 @@ class basic_value
     basic_value(const array_type& ary, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::array),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->array_, ary);
@@ -1138,11 +1164,28 @@ class basic_value
     basic_value(const table_type& tab, detail::region reg,
                 std::vector<std::string> cm)
         : type_(value_t::table),
-          region_info_(std::make_shared<detail::region>(std::move(reg))),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
           comments_(std::move(cm))
     {
         assigner(this->table_, tab);
     }
+    // the parser moves the arrays and tables it builds into the values.
+    basic_value(array_type&& ary, detail::region reg,
+                std::vector<std::string> cm)
+        : type_(value_t::array),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
+          comments_(std::move(cm))
+    {
+        assigner(this->array_, std::move(ary));
+    }
+    basic_value(table_type&& tab, detail::region reg,
+                std::vector<std::string> cm)
+        : type_(value_t::table),
+          region_info_(detail::make_region_info<comment_type>(std::move(reg))),
+          comments_(std::move(cm))
+    {
+        assigner(this->table_, std::move(tab));
+    }
 
     template<typename T, typename std::enable_if<
         detail::is_exact_toml_type<T, value_type>::value,